@@ -0,0 +1,188 @@
+#include <visp_ros/vpROSRobotPioneer.h>
+#include <visp_ros/vpROSSimulatedBase.h>
+
+#include <ros/ros.h>
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <string>
+
+/*
+  Control loop benchmark on a simulated base.
+
+  A vpROSRobotPioneer tracks a circular trajectory on an in-process
+  vpROSSimulatedBase, with a fixed rate loop reading the odometry and sending
+  the velocity. The loop timing and the tracking error with respect to the
+  ground truth of the simulation are reported at the end. Only a running
+  roscore is needed.
+
+  % rosrun visp_ros visp_ros_benchmark_pioneer _duration:=20 _loop_rate:=100 _odom_rate:=50 _latency:=0.04
+
+  _stamped:=true runs the stamped command path (geometry_msgs::TwistStamped).
+*/
+
+namespace {
+
+double monotonicTime()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)t.tv_sec + (double)t.tv_nsec / 1000000000.0;
+}
+
+double wrap(double a)
+{
+  return atan2(sin(a), cos(a));
+}
+
+}
+
+int main( int argc, char** argv )
+{
+  ros::init(argc,argv, "visp_ros_benchmark_pioneer", ros::init_options::AnonymousName);
+  ros::NodeHandle n(std::string("~"));
+
+  double duration, loop_rate, odom_rate, latency, noise_linear, noise_angular, command_rate;
+  double radius, speed;
+  bool prediction, measure_latency, stamped;
+  n.param("duration", duration, 20.0);
+  n.param("loop_rate", loop_rate, 100.0);
+  n.param("odom_rate", odom_rate, 50.0);
+  n.param("latency", latency, 0.04);
+  n.param("noise_linear", noise_linear, 0.0);
+  n.param("noise_angular", noise_angular, 0.0);
+  n.param("command_rate", command_rate, 0.0);
+  n.param("radius", radius, 1.0);
+  n.param("speed", speed, 0.3);
+  n.param("prediction", prediction, false);
+  n.param("measure_latency", measure_latency, true);
+  n.param("stamped", stamped, false);
+
+  vpROSSimulatedBase base;
+  base.setRate(odom_rate);
+  base.setLatency(latency);
+  base.setNoise(noise_linear, noise_angular);
+  base.setCommandStamped(stamped);
+  base.start();
+
+  vpROSRobotPioneer robot;
+  if(prediction)
+    robot.setPrediction(vpROSRobot::PREDICTION_CONSTANT_VELOCITY);
+  robot.setCommandRate(command_rate);
+  robot.setCommandStamped(stamped);
+  robot.setLatencyMeasurement(measure_latency);
+  robot.init(argc, argv);
+
+  // Wait for the first odometry message
+  vpColVector vel;
+  struct timespec stamp;
+  stamp.tv_sec = stamp.tv_nsec = 0;
+  double t_wait = monotonicTime();
+  while(ros::ok() && stamp.tv_sec == 0 && stamp.tv_nsec == 0){
+    if(monotonicTime() - t_wait > 5.){
+      ROS_ERROR("No odometry received from the simulated base, is roscore running?");
+      return -1;
+    }
+    usleep(10000);
+    robot.vpROSRobot::getVelocity(vpRobot::REFERENCE_FRAME, vel, stamp);
+  }
+
+  // Kanayama tracking controller gains
+  const double kx = 1., ky = 4., kth = 2.;
+  const double w_ref = speed / radius;
+  const long period_ns = (long)(1000000000.0 / loop_rate);
+
+  unsigned long iter = 0, overruns = 0;
+  double compute_sum = 0., compute_max = 0., jitter_sum = 0., jitter_max = 0.;
+  double err_sum2 = 0., err_max = 0.;
+
+  vpColVector pose, v(2);
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  double t0 = monotonicTime();
+
+  while(ros::ok()){
+    deadline.tv_nsec += period_ns;
+    while(deadline.tv_nsec >= 1000000000L){
+      deadline.tv_nsec -= 1000000000L;
+      deadline.tv_sec++;
+    }
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR);
+
+    double t_start = monotonicTime();
+    double late = t_start - ((double)deadline.tv_sec + (double)deadline.tv_nsec / 1000000000.0);
+    double t = t_start - t0;
+    if(t > duration)
+      break;
+
+    // Reference on the circle
+    double xr = radius * sin(w_ref * t);
+    double yr = radius * (1. - cos(w_ref * t));
+    double thr = w_ref * t;
+
+    robot.getPosition(vpRobot::REFERENCE_FRAME, pose);
+    double c = cos(pose[5]), s = sin(pose[5]);
+    double ex = c * (xr - pose[0]) + s * (yr - pose[1]);
+    double ey = -s * (xr - pose[0]) + c * (yr - pose[1]);
+    double eth = wrap(thr - pose[5]);
+    v[0] = speed * cos(eth) + kx * ex;
+    v[1] = w_ref + speed * (ky * ey + kth * sin(eth));
+    robot.setVelocity(vpRobot::REFERENCE_FRAME, v);
+
+    double compute = monotonicTime() - t_start;
+
+    // Tracking error with respect to the ground truth
+    double x, y, theta;
+    base.getPose(x, y, theta);
+    double err = sqrt((xr - x) * (xr - x) + (yr - y) * (yr - y));
+
+    iter++;
+    compute_sum += compute;
+    if(compute > compute_max)
+      compute_max = compute;
+    if(late > 0.){
+      jitter_sum += late;
+      if(late > jitter_max)
+        jitter_max = late;
+    }
+    if(late > 1. / loop_rate){
+      overruns++;
+      clock_gettime(CLOCK_MONOTONIC, &deadline);
+    }
+    err_sum2 += err * err;
+    if(err > err_max)
+      err_max = err;
+  }
+
+  v = 0;
+  robot.setVelocity(vpRobot::REFERENCE_FRAME, v);
+
+  if(iter == 0)
+    return -1;
+
+  printf("Loop: %lu iterations at %0.1f Hz, %lu overruns\n", iter, loop_rate, overruns);
+  printf("  compute time: mean %0.3f ms, max %0.3f ms\n", 1000. * compute_sum / iter, 1000. * compute_max);
+  printf("  wake up jitter: mean %0.3f ms, max %0.3f ms\n", 1000. * jitter_sum / iter, 1000. * jitter_max);
+  printf("Tracking error: rms %0.4f m, max %0.4f m\n", sqrt(err_sum2 / iter), err_max);
+  if(command_rate > 0.){
+    vpROSRobot::vpROSCommandStats cmd_stats;
+    robot.getCommandStats(cmd_stats);
+    printf("Command publisher: %lu published, %lu coalesced, %lu overruns, jitter mean %0.3f ms, max %0.3f ms\n",
+           cmd_stats.published, cmd_stats.coalesced, cmd_stats.overruns,
+           1000. * cmd_stats.jitter_mean, 1000. * cmd_stats.jitter_max);
+  }
+  if(measure_latency){
+    vpROSRobot::vpROSLatencyStats latency_stats;
+    robot.getLatencyStats(latency_stats);
+    printf("Command to odometry latency: %lu measured, %lu lost, mean %0.1f ms, min %0.1f ms, max %0.1f ms\n",
+           latency_stats.measured, latency_stats.lost,
+           1000. * latency_stats.mean, 1000. * latency_stats.min, 1000. * latency_stats.max);
+  }
+
+  base.stop();
+  return 0;
+}
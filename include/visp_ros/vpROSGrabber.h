@@ -59,6 +59,14 @@
 #include <sensor_msgs/Image.h>
 #include <visp_bridge/camera.h>
 #include <image_geometry/pinhole_camera_model.h>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/future.hpp>
+#include <deque>
+#include <vector>
 
 #if VISP_HAVE_OPENCV_VERSION >= 0x020101
 #    include <opencv2/highgui/highgui.hpp>
@@ -99,6 +107,16 @@ int main()
  */
 class VISP_EXPORT vpROSGrabber : public vpFrameGrabber
 {
+	public:
+		/*!
+		  Image delivered by acquireAsync() and by the frame callback.
+		 */
+		struct Frame
+		{
+			cv::Mat image;             //!< Acquired image (BGR), shared and read-only.
+			struct timespec timestamp; //!< Timestamp of the acquired image.
+		};
+
 	protected:
 		ros::NodeHandle *n;
 		ros::Subscriber image_data;
@@ -111,7 +129,8 @@ class VISP_EXPORT vpROSGrabber : public vpFrameGrabber
 		cv::Mat data;
 		bool flip;
 		volatile bool _rectify;
-		volatile bool mutex_image, mutex_param;
+		boost::mutex mutex_image, mutex_param;
+		boost::condition_variable cond_image, cond_param;
 		void imageCallbackRaw(const sensor_msgs::Image::ConstPtr& msg);
 		void imageCallback(const sensor_msgs::CompressedImage::ConstPtr& msg);
 		void paramCallback(const sensor_msgs::CameraInfo::ConstPtr& msg);
@@ -123,6 +142,30 @@ class VISP_EXPORT vpROSGrabber : public vpFrameGrabber
 		std::string _nodespace;	
 		std::string _image_transport;
 		vpCameraParameters _cam;
+		double _max_rate;
+		unsigned int _decimation;
+		unsigned int _decimation_count;
+		ros::Time _next_stamp;
+		boost::mutex mutex_throttle;
+		bool dropFrame(const ros::Time &header_stamp);
+		std::vector< boost::shared_ptr< boost::promise<Frame> > > pending_frames;
+		boost::function<void(const Frame&)> frame_callback;
+		std::vector<boost::thread *> worker_threads;
+		std::deque<Frame> frame_queue;
+		boost::mutex mutex_worker;
+		boost::condition_variable cond_worker;
+		bool stop_workers;
+		unsigned int frame_queue_size;
+		void dispatchFrame();
+		void frameWorker();
+		void stopWorkers();
+		cv::Mat decode_buffer;
+		cv::Mat back_buffer;
+		std::vector<cv::Mat> frame_pool;
+		size_t frame_pool_next;
+		unsigned long pool_misses;
+		void allocateBuffers(unsigned int width, unsigned int height);
+		cv::Mat copyToPool();
 	public:
 
 		vpROSGrabber();
@@ -146,6 +189,9 @@ class VISP_EXPORT vpROSGrabber : public vpFrameGrabber
 		bool acquireNoWait(vpImage<unsigned char> &I, struct timespec &timestamp);
 		bool acquireNoWait(vpImage<vpRGBa> &I, struct timespec &timestamp);
 
+		boost::unique_future<Frame> acquireAsync();
+		void setFrameCallback(boost::function<void(const Frame&)> callback, unsigned int nthreads = 1);
+
 		void close();
 
 		void setCameraInfoTopic(std::string topic_name);
@@ -155,6 +201,10 @@ class VISP_EXPORT vpROSGrabber : public vpFrameGrabber
 		void setImageTransport(std::string image_transport);
 		void setFlip(bool flipType);
 		void setRectify(bool rectify);
+		void setMaxRate(double hz);
+		void setDecimation(unsigned int n);
+		void setBufferPoolSize(unsigned int n);
+		unsigned long getBufferPoolMisses();
 
 		void getCameraInfo(vpCameraParameters &cam);
 		void getWidth(unsigned short &width) const;
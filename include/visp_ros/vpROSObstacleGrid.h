@@ -0,0 +1,99 @@
+/****************************************************************************
+ *
+ * $Id: vpROSObstacleGrid.h $
+ *
+ * This file is part of the ViSP software.
+ * Copyright (C) 2005 - 2014 by INRIA. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact INRIA about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://www.irisa.fr/lagadic/visp/visp.html for more information.
+ *
+ * This software was developed at:
+ * INRIA Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ * http://www.irisa.fr/lagadic
+ *
+ * If you have questions regarding the use of this file, please contact
+ * INRIA at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *
+ * Description:
+ * Robot centered grid of inflated obstacles.
+ *
+ * Authors:
+ * agent
+ *
+ *****************************************************************************/
+
+/*!
+  \file vpROSObstacleGrid.h
+  \brief Robot centered grid of inflated obstacles.
+*/
+
+#ifndef vpROSObstacleGrid_h
+#define vpROSObstacleGrid_h
+
+#include <visp/vpConfig.h>
+#include <cstddef>
+#include <vector>
+
+/*!
+  \class vpROSObstacleGrid
+
+  \brief Small grid centered on the robot, holding the obstacles seen by its
+  range sensors inflated by the robot radius.
+
+  Each obstacle point marks the disk of cells within the robot radius, so
+  that checking whether the robot collides at a given position is a single
+  cell lookup. The grid is updated incrementally: the points of a source
+  (laser, sonar...) given to update() only replace the previous points of
+  this source, and only the cells around the old and new points are touched.
+*/
+class VISP_EXPORT vpROSObstacleGrid
+{
+  public:
+    vpROSObstacleGrid(double size = 4., double resolution = 0.05, double radius = 0.3);
+
+    void setGeometry(double size, double resolution, double radius);
+    void clear();
+    void update(unsigned int source, const float *x, const float *y, size_t n);
+
+    bool isOccupied(double x, double y) const;
+    double getFreeDistance(double v, double w, double max_distance) const;
+
+    //! Size of the side of the grid in meters.
+    double getSize() const { return _cells_per_side * _resolution; }
+    //! Size of a cell in meters.
+    double getResolution() const { return _resolution; }
+    //! Radius of the robot in meters.
+    double getRadius() const { return _radius; }
+
+  protected:
+    int cellIndex(double x, double y) const;
+    void mark(int cell, int delta);
+    bool covers(int point, int cell) const;
+    double distanceTo(const std::vector<int> &points, double x, double y) const;
+
+    double _resolution;
+    double _radius;
+    int _cells_per_side;
+    std::vector<unsigned int> cells;          //!< Number of obstacle points covering each cell.
+    std::vector<int> disk_dx, disk_dy;        //!< Cells covered by the robot around a point.
+    std::vector<std::vector<int> > marked;    //!< Cells of the points of each source.
+};
+
+#endif
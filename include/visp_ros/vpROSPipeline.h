@@ -0,0 +1,198 @@
+/****************************************************************************
+ *
+ * $Id: vpROSPipeline.h $
+ *
+ * This file is part of the ViSP software.
+ * Copyright (C) 2005 - 2014 by INRIA. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact INRIA about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://www.irisa.fr/lagadic/visp/visp.html for more information.
+ *
+ * This software was developed at:
+ * INRIA Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ * http://www.irisa.fr/lagadic
+ *
+ * If you have questions regarding the use of this file, please contact
+ * INRIA at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *
+ * Description:
+ * Staged image processing pipeline fed by vpROSGrabber.
+ *
+ * Authors:
+ * agent
+ *
+ *****************************************************************************/
+
+/*!
+  \file vpROSPipeline.h
+  \brief Staged image processing pipeline fed by vpROSGrabber.
+*/
+
+#ifndef vpROSPipeline_h
+#define vpROSPipeline_h
+
+#include <visp/vpConfig.h>
+
+#if defined(VISP_HAVE_OPENCV)
+
+#include <visp_ros/vpROSGrabber.h>
+#include <visp_ros/vpROSPipelineQueue.h>
+#include <boost/any.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <string>
+#include <vector>
+
+/*!
+  \class vpROSPipelineFrame
+  \brief Data flowing through the stages of a vpROSPipeline.
+*/
+class VISP_EXPORT vpROSPipelineFrame
+{
+  public:
+    cv::Mat image;             //!< Image given by the grabber (shared, copy before modifying it in place).
+    struct timespec timestamp; //!< Timestamp of the image.
+    unsigned long seq;         //!< Sequence number given by the source stage.
+    double t_source;           //!< Monotonic time (s) at which the image entered the pipeline.
+    boost::any data;           //!< Result of the previous stages, for the next ones.
+};
+
+typedef boost::shared_ptr<vpROSPipelineFrame> vpROSPipelineFramePtr;
+
+/*!
+  \class vpROSPipelineStage
+
+  \brief Base class of a processing stage of a vpROSPipeline.
+
+  Each stage runs on its own thread and is fed by the bounded queue it was
+  added with. Implement process() to do the stage work.
+*/
+class VISP_EXPORT vpROSPipelineStage
+{
+  public:
+    vpROSPipelineStage(const std::string &name) : _name(name) {}
+    virtual ~vpROSPipelineStage() {}
+
+    /*!
+      Process a frame.
+      \param frame : Frame to process, modified in place for the next stages.
+      \return false to drop the frame, true to forward it to the next stage.
+    */
+    virtual bool process(vpROSPipelineFrame &frame) = 0;
+
+    const std::string &getName() const { return _name; }
+
+  protected:
+    std::string _name;
+};
+
+/*!
+  \class vpROSPipelineStageStats
+  \brief Statistics of a pipeline stage, see vpROSPipeline::getStats().
+*/
+class VISP_EXPORT vpROSPipelineStageStats
+{
+  public:
+    std::string name;        //!< Name of the stage.
+    unsigned long processed; //!< Number of processed frames.
+    unsigned long rejected;  //!< Number of frames dropped by process().
+    unsigned long dropped;   //!< Number of frames dropped by the input queue overflow policy.
+    double latency_mean;     //!< Mean duration of process() in seconds.
+    double latency_max;      //!< Maximum duration of process() in seconds.
+    double age_mean;         //!< Mean time between pipeline entry and the end of this stage in seconds.
+    size_t queue_depth;      //!< Current number of frames waiting in the input queue.
+    size_t queue_capacity;   //!< Capacity of the input queue.
+};
+
+/*!
+  \class vpROSPipeline
+
+  \brief Staged image processing pipeline with vpROSGrabber as source.
+
+  The grabber frame callback is the source stage. Each user stage runs on its
+  own thread and is connected to the previous one by a bounded lock-free
+  queue with a configurable overflow policy.
+
+  \code
+class Detect : public vpROSPipelineStage
+{
+public:
+  Detect() : vpROSPipelineStage("detect") {}
+  bool process(vpROSPipelineFrame &frame) { ...; frame.data = result; return true; }
+};
+
+vpROSGrabber g;
+g.open();
+vpROSPipeline pipeline(g);
+Detect detect;
+Track track;
+pipeline.addStage(&detect);
+pipeline.addStage(&track, 2, vpROSPipelineQueuePolicy::BLOCK);
+pipeline.start();
+  \endcode
+*/
+class VISP_EXPORT vpROSPipeline
+{
+  public:
+    typedef vpROSPipelineQueuePolicy::vpOverflowPolicy vpOverflowPolicy;
+
+    vpROSPipeline(vpROSGrabber &grabber);
+    virtual ~vpROSPipeline();
+
+    void addStage(vpROSPipelineStage *stage, unsigned int queue_size = 2,
+                  vpOverflowPolicy policy = vpROSPipelineQueuePolicy::DROP_OLDEST);
+    void start();
+    void stop();
+    bool isRunning() const { return running; }
+
+    void getStats(std::vector<vpROSPipelineStageStats> &stats);
+    void resetStats();
+
+  protected:
+    class StageContext
+    {
+      public:
+        StageContext(vpROSPipelineStage *s, unsigned int queue_size, vpOverflowPolicy policy)
+          : stage(s), queue(queue_size, policy), thread(NULL) { reset(); }
+        void reset() { processed = rejected = 0; latency_sum = latency_max = age_sum = 0.; }
+
+        vpROSPipelineStage *stage;
+        vpROSPipelineQueue<vpROSPipelineFramePtr> queue;
+        boost::thread *thread;
+        boost::mutex stats_mutex;
+        unsigned long processed, rejected;
+        double latency_sum, latency_max, age_sum;
+    };
+
+    void sourceCallback(const vpROSGrabber::Frame &frame);
+    void stageLoop(size_t index);
+
+    vpROSGrabber &grabber;
+    std::vector<StageContext *> stages;
+    unsigned long seq;
+    bool running;
+
+  private:
+    vpROSPipeline(const vpROSPipeline &);
+    vpROSPipeline &operator=(const vpROSPipeline &);
+};
+
+#endif
+#endif
@@ -0,0 +1,297 @@
+/****************************************************************************
+ *
+ * $Id: vpROSPipelineQueue.h $
+ *
+ * This file is part of the ViSP software.
+ * Copyright (C) 2005 - 2014 by INRIA. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact INRIA about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://www.irisa.fr/lagadic/visp/visp.html for more information.
+ *
+ * This software was developed at:
+ * INRIA Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ * http://www.irisa.fr/lagadic
+ *
+ * If you have questions regarding the use of this file, please contact
+ * INRIA at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *
+ * Description:
+ * Bounded lock-free queue used between pipeline stages.
+ *
+ * Authors:
+ * agent
+ *
+ *****************************************************************************/
+
+/*!
+  \file vpROSPipelineQueue.h
+  \brief Bounded lock-free queue used between pipeline stages.
+*/
+
+#ifndef vpROSPipelineQueue_h
+#define vpROSPipelineQueue_h
+
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <cstddef>
+
+/*!
+  \class vpROSPipelineQueuePolicy
+  \brief Overflow policies of vpROSPipelineQueue.
+*/
+class vpROSPipelineQueuePolicy
+{
+  public:
+    typedef enum {
+      DROP_OLDEST, //!< When full, the oldest item is removed to make room for the new one.
+      BLOCK        //!< When full, the producer waits until an item is consumed.
+    } vpOverflowPolicy;
+};
+
+/*!
+  \class vpROSPipelineQueue
+
+  \brief Bounded multi-producer multi-consumer lock-free queue.
+
+  Each slot carries a sequence number so that producers and consumers only
+  synchronize through atomic operations. The capacity is rounded up to the
+  next power of two. Waiting (empty queue, or full queue with the
+  vpROSPipelineQueuePolicy::BLOCK policy) yields a few times, then blocks on
+  a condition variable. The mutex is only taken by a waiting thread, and by
+  the opposite side when it knows that a thread is waiting.
+*/
+template<class T>
+class vpROSPipelineQueue : public vpROSPipelineQueuePolicy
+{
+  public:
+    vpROSPipelineQueue(unsigned int capacity, vpOverflowPolicy policy = DROP_OLDEST)
+      : policy_(policy), closed_(false), dropped_(0), enqueue_pos_(0), dequeue_pos_(0),
+        push_waiters_(0), pop_waiters_(0)
+    {
+      size_t size = 2;
+      while(size < capacity)
+        size <<= 1;
+      mask_ = size - 1;
+      buffer_ = new Cell[size];
+      for(size_t i = 0; i < size; i++)
+        buffer_[i].sequence.store(i, boost::memory_order_relaxed);
+    }
+
+    ~vpROSPipelineQueue()
+    {
+      delete [] buffer_;
+    }
+
+    /*!
+      Insert an item without waiting.
+      \return false if the queue is full.
+    */
+    bool tryPush(const T &item)
+    {
+      Cell *cell;
+      size_t pos = enqueue_pos_.load(boost::memory_order_relaxed);
+      for(;;){
+        cell = &buffer_[pos & mask_];
+        size_t seq = cell->sequence.load(boost::memory_order_acquire);
+        std::ptrdiff_t dif = (std::ptrdiff_t)seq - (std::ptrdiff_t)pos;
+        if(dif == 0){
+          if(enqueue_pos_.compare_exchange_weak(pos, pos + 1, boost::memory_order_relaxed))
+            break;
+        }
+        else if(dif < 0)
+          return false;
+        else
+          pos = enqueue_pos_.load(boost::memory_order_relaxed);
+      }
+      cell->data = item;
+      cell->sequence.store(pos + 1, boost::memory_order_release);
+      return true;
+    }
+
+    /*!
+      Remove an item without waiting.
+      \return false if the queue is empty.
+    */
+    bool tryPop(T &item)
+    {
+      Cell *cell;
+      size_t pos = dequeue_pos_.load(boost::memory_order_relaxed);
+      for(;;){
+        cell = &buffer_[pos & mask_];
+        size_t seq = cell->sequence.load(boost::memory_order_acquire);
+        std::ptrdiff_t dif = (std::ptrdiff_t)seq - (std::ptrdiff_t)(pos + 1);
+        if(dif == 0){
+          if(dequeue_pos_.compare_exchange_weak(pos, pos + 1, boost::memory_order_relaxed))
+            break;
+        }
+        else if(dif < 0)
+          return false;
+        else
+          pos = dequeue_pos_.load(boost::memory_order_relaxed);
+      }
+      item = cell->data;
+      cell->data = T();
+      cell->sequence.store(pos + mask_ + 1, boost::memory_order_release);
+      return true;
+    }
+
+    /*!
+      Insert an item according to the overflow policy.
+      \return false if the queue was closed before the item could be inserted.
+    */
+    bool push(const T &item)
+    {
+      for(unsigned int spins = 0; !tryPush(item); spins++){
+        if(closed_.load(boost::memory_order_relaxed))
+          return false;
+        if(policy_ == DROP_OLDEST){
+          T oldest;
+          if(tryPop(oldest))
+            dropped_.fetch_add(1, boost::memory_order_relaxed);
+          else
+            boost::this_thread::yield();
+        }
+        else if(spins < spin_count)
+          boost::this_thread::yield();
+        else{
+          if(!waitPush(item))
+            return false;
+          break;
+        }
+      }
+      wake(pop_waiters_, not_empty_);
+      return true;
+    }
+
+    /*!
+      Remove an item, waiting until one is available.
+      \return false if the queue is closed and empty.
+    */
+    bool pop(T &item)
+    {
+      for(unsigned int spins = 0; !tryPop(item); spins++){
+        if(closed_.load(boost::memory_order_relaxed))
+          return false;
+        if(spins < spin_count)
+          boost::this_thread::yield();
+        else{
+          if(!waitPop(item))
+            return false;
+          break;
+        }
+      }
+      wake(push_waiters_, not_full_);
+      return true;
+    }
+
+    //! Wake up the waiting producers and consumers and make them return false.
+    void close()
+    {
+      closed_.store(true, boost::memory_order_relaxed);
+      boost::mutex::scoped_lock lock(mutex_);
+      not_empty_.notify_all();
+      not_full_.notify_all();
+    }
+    //! Reopen a closed queue.
+    void open() { closed_.store(false, boost::memory_order_relaxed); }
+
+    //! Approximate number of queued items.
+    size_t size() const
+    {
+      size_t e = enqueue_pos_.load(boost::memory_order_relaxed);
+      size_t d = dequeue_pos_.load(boost::memory_order_relaxed);
+      return (e > d) ? e - d : 0;
+    }
+
+    //! Queue capacity.
+    size_t capacity() const { return mask_ + 1; }
+    //! Number of items removed by the DROP_OLDEST policy.
+    unsigned long getDropped() const { return dropped_.load(boost::memory_order_relaxed); }
+
+  private:
+    struct Cell
+    {
+      boost::atomic<size_t> sequence;
+      T data;
+    };
+
+    // Number of yields before a waiting thread blocks
+    static const unsigned int spin_count = 64;
+
+    /*
+      Slow paths of push() and pop(). The waiter is registered before trying
+      again, and the other side checks the waiters after its own operation,
+      both behind a full fence: either the retry succeeds or the other side
+      sees the waiter. The notification is sent under the mutex, so it cannot
+      fall between the retry and the wait.
+    */
+    bool waitPush(const T &item)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      push_waiters_.fetch_add(1, boost::memory_order_relaxed);
+      boost::atomic_thread_fence(boost::memory_order_seq_cst);
+      bool pushed;
+      while(!(pushed = tryPush(item)) && !closed_.load(boost::memory_order_relaxed))
+        not_full_.wait(lock);
+      push_waiters_.fetch_sub(1, boost::memory_order_relaxed);
+      return pushed;
+    }
+
+    bool waitPop(T &item)
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      pop_waiters_.fetch_add(1, boost::memory_order_relaxed);
+      boost::atomic_thread_fence(boost::memory_order_seq_cst);
+      bool popped;
+      while(!(popped = tryPop(item)) && !closed_.load(boost::memory_order_relaxed))
+        not_empty_.wait(lock);
+      pop_waiters_.fetch_sub(1, boost::memory_order_relaxed);
+      return popped;
+    }
+
+    void wake(boost::atomic<unsigned int> &waiters, boost::condition_variable &cond)
+    {
+      boost::atomic_thread_fence(boost::memory_order_seq_cst);
+      if(waiters.load(boost::memory_order_relaxed) != 0){
+        boost::mutex::scoped_lock lock(mutex_);
+        cond.notify_one();
+      }
+    }
+
+    // Not copyable
+    vpROSPipelineQueue(const vpROSPipelineQueue &);
+    vpROSPipelineQueue &operator=(const vpROSPipelineQueue &);
+
+    Cell *buffer_;
+    size_t mask_;
+    vpOverflowPolicy policy_;
+    boost::atomic<bool> closed_;
+    boost::atomic<unsigned long> dropped_;
+    boost::atomic<size_t> enqueue_pos_;
+    boost::atomic<size_t> dequeue_pos_;
+    boost::atomic<unsigned int> push_waiters_;
+    boost::atomic<unsigned int> pop_waiters_;
+    boost::mutex mutex_;
+    boost::condition_variable not_empty_;
+    boost::condition_variable not_full_;
+};
+
+#endif
@@ -49,9 +49,21 @@
 */
 
 #include <visp/vpRobot.h>
+#include <visp/vpHomogeneousMatrix.h>
+#include <visp/vpVelocityTwistMatrix.h>
+#include <visp_ros/vpROSSeqLock.h>
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
 #include <nav_msgs/Odometry.h>
 #include <geometry_msgs/Twist.h>
+#include <geometry_msgs/TwistStamped.h>
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/future.hpp>
+#include <boost/shared_ptr.hpp>
+#include <vector>
+#include <pthread.h>
 /*!
 \class vpROSRobot
 \brief vpRobot implementation for Quickie Salsa M wheelchair with ROS.
@@ -59,22 +71,161 @@
 
 class VISP_EXPORT vpROSRobot : public vpRobot
 {
+public:
+	/*!
+	  Extrapolation of the odometry between two messages.
+	 */
+	typedef enum {
+		PREDICTION_NONE,                  /*!< Return the last received odometry. */
+		PREDICTION_CONSTANT_VELOCITY,     /*!< Extrapolate with the last received twist. */
+		PREDICTION_CONSTANT_ACCELERATION  /*!< Extrapolate with the last twist and its derivative. */
+	} vpPredictionType;
+
+	/*!
+	  Statistics of the fixed rate command publisher, see getCommandStats().
+	 */
+	struct vpROSCommandStats
+	{
+		unsigned long published; //!< Number of published commands.
+		unsigned long coalesced; //!< Number of setVelocity() calls overwritten before being published.
+		unsigned long overruns;  //!< Number of periods missed because the thread woke up too late.
+		double jitter_mean;      //!< Mean wake up delay after the deadline in seconds.
+		double jitter_max;       //!< Maximum wake up delay after the deadline in seconds.
+		unsigned long watchdog;  //!< Number of times the command timeout stopped the robot.
+	};
+
+	/*!
+	  Command to odometry latency statistics, see getLatencyStats().
+	 */
+	struct vpROSLatencyStats
+	{
+		unsigned long measured;   //!< Number of measured latencies since the last reset.
+		unsigned long lost;       //!< Number of command steps never observed in the odometry.
+		double last;              //!< Last measured latency in seconds.
+		double mean;              //!< Mean latency over the window in seconds.
+		double min;               //!< Minimum latency over the window in seconds.
+		double max;               //!< Maximum latency over the window in seconds.
+		double bin_width;         //!< Width of the histogram bins in seconds.
+		std::vector<unsigned long> histogram; //!< Latencies of the window, the last bin counts the overflows.
+	};
+
+protected:
+	ros::NodeHandle *n; //!< Node handle of the robot topics, on the robot callback queue.
+	bool own_node;      //!< False when n is shared with other robots, see init(ros::NodeHandle *).
 
 private:
-	ros::NodeHandle *n;
 	ros::Publisher cmdvel;
         ros::Subscriber odom;
-	ros::AsyncSpinner *spinner;
+	ros::CallbackQueue *queue;  //!< Private queue of the odometry callback.
+	boost::thread *spin_thread; //!< Thread serving queue.
+	boost::thread *cmd_thread;
+	boost::atomic<bool> spin_running;
+	int _spin_priority;
+	int _spin_cpu;
 
 protected:
+	/*!
+	  Odometry state shared between the spinner and the user threads.
+	 */
+	struct vpROSOdomState
+	{
+		double p[3];            //!< Position.
+		double q[4];            //!< Orientation as a quaternion (x, y, z, w).
+		double disp_R[9];       //!< Rotation of the displacement accumulated since the beginning (row major).
+		double disp_t[3];       //!< Translation of the displacement accumulated since the beginning.
+		double v[6];            //!< Twist of the last odometry message.
+		double a[6];            //!< Twist derivative estimated from the last two messages.
+		double t_mono;          //!< Monotonic time (s) at which the last message was received.
+		uint32_t sec, nsec;     //!< Stamp of the last odometry message.
+	};
+
+	/*!
+	  Odometry sample kept in the history ring.
+	 */
+	struct vpROSOdomSample
+	{
+		double t;    //!< Stamp in seconds.
+		double p[3]; //!< Position.
+		double q[4]; //!< Orientation as a quaternion (x, y, z, w).
+	};
+
+	/*!
+	  Last velocity given to setVelocity(), read by the command publisher thread.
+	 */
+	struct vpROSCommand
+	{
+		double v[6];       //!< Velocity in the reference frame.
+		unsigned long seq; //!< Number of setVelocity() calls.
+		double t_mono;     //!< Monotonic time (s) of the setVelocity() call.
+		uint32_t sec, nsec; //!< Stamp of the data the command was computed from.
+	};
+
+	/*!
+	  Command step waiting to be observed in the odometry twist.
+	 */
+	struct vpROSLatencyProbe
+	{
+		unsigned long seq; //!< Tag of the step.
+		unsigned int axis; //!< Twist component with the step.
+		double base;       //!< Odometry twist component when the step was published.
+		double target;     //!< Commanded twist component.
+		double t_mono;     //!< Monotonic time (s) at which the step was published.
+	};
+
 	bool isInitialized;
 
-	vpQuaternionVector q;
-    	vpTranslationVector p;
-    	vpColVector pose_prev;
-    	vpColVector displacement;
-    	uint32_t _sec, _nsec;
-    	volatile bool odom_mutex;
+	virtual void initCommunication();
+	virtual void applyControllerVelocity(double v, double w);
+	void odomCallback(const nav_msgs::Odometry::ConstPtr& msg);
+
+    	vpHomogeneousMatrix disp_prev;         //!< Accumulated displacement at the previous getDisplacement() call.
+    	vpROSOdomState odom_state;             //!< Written by the odometry callback only.
+    	vpHomogeneousMatrix odom_disp;         //!< Accumulated displacement, written by the odometry callback only.
+    	std::vector<vpColVector> odom_burst_v; //!< Twists of the current odometry burst, not integrated yet.
+    	std::vector<double> odom_burst_dt;     //!< Durations of the current odometry burst.
+    	vpROSSeqLock<vpROSOdomState> odom_lock; //!< Last published odometry state.
+    	std::vector<vpROSOdomSample> odom_history;    //!< Preallocated ring of odometry samples.
+    	boost::atomic<unsigned long> odom_history_count; //!< Number of samples written in the ring.
+	vpPredictionType _prediction;
+	double _prediction_max_horizon;
+	boost::atomic<double> _prediction_horizon; //!< Horizon of the last prediction, for getPredictionHorizon() only.
+	vpHomogeneousMatrix _cMe;            //!< Robot frame in the camera frame, see set_cMe().
+	vpHomogeneousMatrix _eMc;            //!< Inverse of _cMe.
+	vpVelocityTwistMatrix cVe;           //!< Robot to camera frame twist transformation.
+	vpVelocityTwistMatrix eVc;           //!< Camera to robot frame twist transformation.
+	vpMatrix eVm;                        //!< Mixt frame to robot frame twist transformation.
+	vpROSCommand cmd;                    //!< Written by setVelocity() only.
+	vpROSSeqLock<vpROSCommand> cmd_lock; //!< Last commanded velocity.
+	boost::atomic<bool> cmd_running;
+	bool _cmd_stamped;
+	std::string _cmd_frame;                  //!< Frame of the stamped commands, see setCommandStamped().
+	std::string cmd_frame_id;                //!< Namespaced frame of the stamped commands, set by init().
+	double _cmd_rate;
+	double _cmd_timeout;
+	double _max_acc_linear;
+	double _max_acc_angular;
+	boost::mutex cmd_stats_mutex;
+	vpROSCommandStats cmd_stats;
+	bool _latency_enabled;
+	double _latency_step;
+	double _latency_timeout;
+	double latency_last_cmd[6];                  //!< Last published velocity, written by the publisher only.
+	unsigned long latency_seq;                   //!< Tag of the last step, written by the publisher only.
+	vpROSSeqLock<vpROSLatencyProbe> latency_probe; //!< Last command step.
+	boost::atomic<unsigned long> latency_done;   //!< Tag of the last step observed or given up by the odometry callback.
+	boost::mutex latency_mutex;
+	vpROSLatencyStats latency_stats;
+	std::vector<double> latency_window;          //!< Ring of the last measured latencies.
+	unsigned long latency_count;
+	boost::mutex pos_mutex;                  //!< Protects the position controller state.
+	boost::atomic<bool> pos_active;          //!< A position move is in progress.
+	bool pos_aligning;                       //!< The last waypoint is reached, only the heading is controlled.
+	std::vector<vpColVector> pos_waypoints;  //!< Remaining (x, y, theta) waypoints.
+	boost::shared_ptr< boost::promise<bool> > pos_promise; //!< Completion of the move.
+	double _pos_tolerance;
+	double _pos_angle_tolerance;
+	double _pos_max_v;
+	double _pos_max_w;
 	std::string _master_uri;
 	std::string _topic_cmd;
 	std::string _topic_odom;
@@ -85,6 +236,16 @@ public:
 	//! basic initialization
 	void init() ;
 	void init(int argc, char **argv) ;
+	void init(ros::NodeHandle *shared_node) ;
+
+	/*! Set the namespace of the topics, before init(). \param nodespace : Namespace, ending with a '/'. */
+	void setNodespace(const std::string &nodespace) { _nodespace = nodespace; }
+	/*! Set the velocity command topic, before init(). \param topic : Topic name, "cmd_vel" by default. */
+	void setCmdVelTopic(const std::string &topic) { _topic_cmd = topic; }
+	/*! Set the odometry topic, before init(). \param topic : Topic name, "odom" by default. */
+	void setOdomTopic(const std::string &topic) { _topic_odom = topic; }
+	//! Get the namespace of the topics.
+	const std::string &getNodespace() const { return _nodespace; }
 
 	//! constructor
 	vpROSRobot() ;
@@ -108,24 +269,68 @@ private: // Set as private since not implemented
   */
   void getArticularDisplacement(vpColVector  & /*qdot*/) {};
 
-
-  void getVelocity (const vpRobot::vpControlFrameType frame, vpColVector & velocity);
-  vpColVector getVelocity (const vpRobot::vpControlFrameType frame);
-
-  /*!
-    Set a displacement (frame has to be specified) in position control.
-    \warning Not implemented.
-  */
-  void setPosition(const vpRobot::vpControlFrameType /*frame*/, const vpColVector &/*q*/) {};
-  void odomCallback(const nav_msgs::Odometry::ConstPtr& msg);
+  bool predict(const vpROSOdomState &state, vpHomogeneousMatrix &delta, double &h);
+  void stepPositionController();
+  void finishPosition(bool reached);
   void getCameraDisplacement(vpColVector & /*v*/);
+  void spinLoop();
+  void applySpinnerScheduling(pthread_t thread);
+  void publishVelocity(const double v[6], uint32_t sec, uint32_t nsec);
+  void changeFrame(const vpMatrix &M, const vpColVector &vel, double v[6]);
+  void probeLatency(const double v[6]);
+  void measureLatency(const vpColVector &v);
+  void addLatency(double latency);
+  void startCommandThread();
+  void stopCommandThread();
+  void commandLoop();
 
 public:
     
     void getDisplacement(const vpRobot::vpControlFrameType /*frame*/, vpColVector &/*q*/);
     void getDisplacement(const vpRobot::vpControlFrameType /*frame*/, vpColVector &/*q*/, struct timespec &timestamp);
     void getPosition(const vpRobot::vpControlFrameType /*frame*/, vpColVector &/*q*/);
+    void getPosition(const vpRobot::vpControlFrameType frame, vpColVector &pose, const struct timespec &timestamp);
+    virtual void getVelocity(const vpRobot::vpControlFrameType frame, vpColVector &velocity);
+    void getVelocity(const vpRobot::vpControlFrameType frame, vpColVector &velocity, struct timespec &timestamp);
+    vpColVector getVelocity(const vpRobot::vpControlFrameType frame);
+    virtual void set_cMe(const vpHomogeneousMatrix &cMe);
+    void setOdometryHistorySize(unsigned int size);
+    void setSpinnerPriority(int priority);
+    void setSpinnerAffinity(int cpu);
+    void setPrediction(vpPredictionType type, double max_horizon = 0.2);
+    /*!
+      Get the extrapolation horizon used by the last call to getPosition() or getDisplacement().
+      \return Horizon in seconds, 0 when no prediction was done.
+    */
+    double getPredictionHorizon() const { return _prediction_horizon.load(); }
+
+    void setPosition(const vpRobot::vpControlFrameType frame, const vpColVector &pose);
+    bool setPosition(const vpRobot::vpControlFrameType frame, const vpColVector &pose, double timeout);
+    boost::unique_future<bool> setPositionAsync(const vpRobot::vpControlFrameType frame, const vpColVector &pose);
+    boost::unique_future<bool> setWaypointsAsync(const vpRobot::vpControlFrameType frame, const std::vector<vpColVector> &waypoints);
+    void cancelPosition();
+    //! Return true while a move started by setPosition() or its variants is in progress.
+    bool isPositionActive() const { return pos_active.load(boost::memory_order_acquire); }
+    void setPositionTolerance(double distance, double angle);
+    void setPositionMaxVelocity(double v, double w);
+
+    static void integrateDisplacement(vpHomogeneousMatrix &M, const vpColVector &v, double dt);
+    static void integrateDisplacement(vpHomogeneousMatrix &M, const std::vector<vpColVector> &v, const std::vector<double> &dt);
     void setVelocity(const vpRobot::vpControlFrameType frame, const vpColVector &vel);
+    void setVelocity(const vpRobot::vpControlFrameType frame, const vpColVector &vel, const struct timespec &timestamp);
+    void setCommandStamped(bool stamped, const std::string &frame_id = "base_link");
+
+    void setCommandRate(double hz);
+    //! Get the rate of the command publisher thread in Hz, 0 when disabled.
+    double getCommandRate() const { return _cmd_rate; }
+    void setMaxAcceleration(double linear, double angular);
+    void setCommandTimeout(double timeout);
+    void getCommandStats(vpROSCommandStats &stats);
+    void resetCommandStats();
+
+    void setLatencyMeasurement(bool enable, double step = 0.05, unsigned int window = 100, double timeout = 1.);
+    void getLatencyStats(vpROSLatencyStats &stats);
+    void resetLatencyStats();
 } ;
 
 #endif
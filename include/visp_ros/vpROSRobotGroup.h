@@ -0,0 +1,125 @@
+/****************************************************************************
+ *
+ * $Id: vpROSRobotGroup.h $
+ *
+ * This file is part of the ViSP software.
+ * Copyright (C) 2005 - 2014 by INRIA. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact INRIA about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://www.irisa.fr/lagadic/visp/visp.html for more information.
+ *
+ * This software was developed at:
+ * INRIA Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ * http://www.irisa.fr/lagadic
+ *
+ * If you have questions regarding the use of this file, please contact
+ * INRIA at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *
+ * Description:
+ * Group of vpROSRobot sharing a callback queue and a spinner.
+ *
+ * Authors:
+ * agent
+ *
+ *****************************************************************************/
+
+/*!
+  \file vpROSRobotGroup.h
+  \brief Group of vpROSRobot sharing a callback queue and a spinner.
+*/
+
+#ifndef vpROSRobotGroup_h
+#define vpROSRobotGroup_h
+
+#include <visp/vpConfig.h>
+#include <visp/vpColVector.h>
+#include <visp_ros/vpROSRobot.h>
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <vector>
+
+/*!
+  \class vpROSRobotGroup
+
+  \brief Hosts many vpROSRobot on a single callback queue.
+
+  Each vpROSRobot initialized alone owns a node handle and a thread
+  receiving its odometry. A group shares one node handle between all its
+  robots, and their callbacks are registered on its queue, served by a small
+  pool of threads. The number of threads does not grow with the number of
+  robots: idle threads wait on the queue and any of them runs the next
+  pending callback, whatever its robot.
+
+  The callbacks of a same subscription are never run concurrently. With more
+  than one thread, the different callbacks of a robot may be, such as the
+  odometry, laser and sonar callbacks of a vpROSRobotPioneer. They only share
+  state through sequence locks, atomics or mutexes: the laser and sonar
+  callbacks are serialized on the sensor mutex, and the safety check run
+  from the odometry callback by the position controller only tries to lock
+  it.
+
+  \code
+vpROSRobotGroup group(2);
+for(unsigned int i = 0; i < 20; i++){
+  vpROSRobotPioneer *robot = new vpROSRobotPioneer;
+  std::ostringstream ns;
+  ns << "robot" << i << "/";
+  robot->setNodespace(ns.str());
+  group.add(robot);
+}
+group.init(argc, argv);
+
+std::vector<vpColVector> poses, vel(group.size(), vpColVector(2));
+group.getPosition(vpRobot::REFERENCE_FRAME, poses);
+...
+group.setVelocity(vpRobot::REFERENCE_FRAME, vel);
+  \endcode
+*/
+class VISP_EXPORT vpROSRobotGroup
+{
+  public:
+    vpROSRobotGroup(unsigned int nthreads = 2);
+    virtual ~vpROSRobotGroup();
+
+    size_t add(vpROSRobot *robot);
+    void init(int argc, char **argv);
+
+    //! Number of robots in the group.
+    size_t size() const { return robots.size(); }
+    //! Access to a robot of the group. \param i : Index given by add().
+    vpROSRobot &operator[](size_t i) { return *robots[i]; }
+
+    void setVelocity(const vpRobot::vpControlFrameType frame, const std::vector<vpColVector> &vel);
+    void getPosition(const vpRobot::vpControlFrameType frame, std::vector<vpColVector> &pose);
+    void getVelocity(const vpRobot::vpControlFrameType frame, std::vector<vpColVector> &vel);
+
+  protected:
+    ros::CallbackQueue queue;
+    ros::NodeHandle *n; //!< Node handle shared by all the robots, on queue.
+    ros::AsyncSpinner *spinner;
+    std::vector<vpROSRobot *> robots;
+    unsigned int _nthreads;
+    bool isInitialized;
+
+  private:
+    vpROSRobotGroup(const vpROSRobotGroup &);
+    vpROSRobotGroup &operator=(const vpROSRobotGroup &);
+};
+
+#endif
@@ -0,0 +1,635 @@
+/****************************************************************************
+ *
+ * $Id: vpROSRobotNode.h $
+ *
+ * This file is part of the ViSP software.
+ * Copyright (C) 2005 - 2014 by INRIA. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact INRIA about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://www.irisa.fr/lagadic/visp/visp.html for more information.
+ *
+ * This software was developed at:
+ * INRIA Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ * http://www.irisa.fr/lagadic
+ *
+ * If you have questions regarding the use of this file, please contact
+ * INRIA at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *
+ * Description:
+ * Generic ROS node exposing a ViSP robot.
+ *
+ * Authors:
+ * agent
+ *
+ *****************************************************************************/
+
+/*!
+  \file vpROSRobotNode.h
+  \brief Generic ROS node exposing a ViSP robot.
+*/
+
+#ifndef vpROSRobotNode_h
+#define vpROSRobotNode_h
+
+#include <visp/vpConfig.h>
+#include <visp/vpColVector.h>
+#include <visp/vpRobot.h>
+#include <visp/vpRobotException.h>
+#include <ros/ros.h>
+#include <geometry_msgs/PoseStamped.h>
+#include <geometry_msgs/TwistStamped.h>
+#include <sensor_msgs/JointState.h>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
+#include <visp_ros/vpROSSeqLock.h>
+#include <cstring>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <string>
+#include <time.h>
+
+/*!
+  \class vpROSRobotNodeState
+  \brief Robot state read by the hardware thread of vpROSRobotNode.
+*/
+template<unsigned int N>
+struct vpROSRobotNodeState
+{
+  double q[N];        //!< Joint positions.
+  double qdot[N];     //!< Joint velocities.
+  double pose[7];     //!< Published pose: x, y, z, qx, qy, qz, qw.
+  double twist[6];    //!< Published velocity: vx, vy, vz, wx, wy, wz.
+  double stamp;       //!< Time of the read in seconds, shared by all the published messages.
+  unsigned long seq;  //!< Number of reads.
+};
+
+/*!
+  \class vpROSRobotNodeLoopStats
+  \brief Timing statistics of a vpROSRobotNode thread.
+*/
+struct vpROSRobotNodeLoopStats
+{
+  unsigned long cycles;   //!< Number of iterations.
+  unsigned long overruns; //!< Number of iterations that ended after their deadline.
+  unsigned long missed;   //!< Number of periods skipped because of the overruns.
+  double late_max;        //!< Largest overrun in seconds.
+  unsigned long skipped;  //!< Publishing thread only: states older than one publishing period never published.
+};
+
+/*!
+  \class vpROSRobotNodeError
+  \brief Last robot error caught by the hardware thread of vpROSRobotNode.
+*/
+struct vpROSRobotNodeError
+{
+  char message[256];   //!< Message of the last exception, truncated.
+  unsigned long count; //!< Number of caught exceptions.
+};
+
+/*!
+  \class vpROSRobotNodeCommand
+  \brief Last command received by vpROSRobotNode, applied by its hardware thread.
+*/
+template<unsigned int N>
+struct vpROSRobotNodeCommand
+{
+  typedef enum { NONE, VELOCITY, POSITION } vpCommandType;
+
+  vpCommandType type;
+  double v[(N > 6) ? N : 6]; //!< Velocity in the command frame, or joint positions.
+  unsigned long seq;         //!< Number of received commands.
+};
+
+/*!
+  \class vpROSRobotNode
+
+  \brief ROS node exposing a ViSP robot: publishes its pose (and velocity)
+  and applies the velocity or position commands it receives.
+
+  The robot is only accessed by a hardware thread running at the native rate
+  of the controller: each period it applies the last received command and
+  reads the robot state. The command callbacks and the publishing thread
+  exchange data with it through sequence locks, so that ROS never waits for
+  the hardware and conversely. A command is applied at the beginning of the
+  next hardware period, so it reaches the robot after at most one period
+  plus the duration of the read in progress. The hardware thread may run
+  with a real-time priority, see setHardwarePriority().
+
+  A vpRobotException thrown by the robot in the hardware thread stops the
+  robot with stopMotion() and the loop goes on with the next command. The
+  error is logged by the publishing thread, out of the real-time path.
+
+  When Traits::blockingPosition() is true, setPosition() only returns once
+  the robot reached the position. The position commands are then applied
+  by a separate thread, while the hardware thread keeps reading and
+  publishing the robot state. The commands received during the motion are
+  held, and the last one is applied when the motion ends.
+
+  The following private parameters are read by the constructor:
+  - \e rate : publishing rate in Hz, Traits::rate() by default.
+  - \e hardware_rate : rate of the hardware thread in Hz, Traits::hardwareRate() by default.
+  - \e queue_size : depth of the state publisher queues, 10 by default.
+    When a subscriber lags by more than \e queue_size messages, roscpp drops
+    the oldest queued ones. Set it to 1 so that a slow subscriber always
+    gets the most recent state only.
+
+  Both threads count the iterations that overrun their period, see
+  getHardwareStats() and getPublishStats(). A summary is logged at shutdown.
+
+  The robot specific parts are given by the \e Traits class, with static
+  members only:
+  \code
+struct vpROSMyRobotTraits
+{
+  enum { njoints = 6 };                        // Number of joints
+  typedef geometry_msgs::TwistStamped VelocityMsg; // Velocity command message
+  typedef geometry_msgs::Pose PositionMsg;     // Position command message
+  struct Scratch;                              // Buffers of read(), one per node
+  static const char *name();                   // Name for the logs
+  static const char *poseTopic();              // Published geometry_msgs::PoseStamped
+  static const char *velocityTopic();          // Published geometry_msgs::TwistStamped, NULL if none
+  static const char *jointStateTopic();        // Published sensor_msgs::JointState, NULL if none
+  static const char *jointName(unsigned int i); // Name of joint i in the joint states
+  static const char *velocityCommandTopic();   // Subscribed VelocityMsg
+  static const char *positionCommandTopic();   // Subscribed PositionMsg, NULL if none
+  static vpRobot::vpControlFrameType velocityFrame(); // Frame of the velocity commands
+  static double rate();                        // Default publishing rate in Hz
+  static double hardwareRate();                // Default rate of the hardware thread in Hz
+  static bool blockingPosition();              // True if setPosition() waits for the end of the motion
+  static RobotT *create(Scratch &scratch);     // Allocate and configure the robot, size the buffers
+  static void velocity(const VelocityMsg &msg, double v[]);   // Message to command vector
+  static void position(const PositionMsg &msg, double q[]);   // Message to joint positions
+  static void read(RobotT &robot, Scratch &scratch, vpROSRobotNodeState<njoints> &state); // Hardware read
+};
+  \endcode
+  The buffers used by read() live in the node and are allocated once by
+  create(), so that the hardware reads do not allocate memory.
+
+  A new robot only needs its traits and a main() instantiating the node,
+  see nodes/afma6.cpp and nodes/biclops.cpp.
+*/
+template<class RobotT, class Traits>
+class vpROSRobotNode
+{
+  public:
+    typedef vpROSRobotNodeState<Traits::njoints> State;
+    typedef vpROSRobotNodeCommand<Traits::njoints> Command;
+
+    vpROSRobotNode(ros::NodeHandle nh);
+    virtual ~vpROSRobotNode();
+
+    void setHardwarePriority(int priority);
+    int setup();
+    void spin();
+
+    vpROSRobotNodeLoopStats getHardwareStats() const { return hw_stats.load(); }
+    vpROSRobotNodeLoopStats getPublishStats() const { return pub_stats.load(); }
+
+  protected:
+    void velocityCallback(const typename Traits::VelocityMsg::ConstPtr &msg);
+    void positionCallback(const typename Traits::PositionMsg::ConstPtr &msg);
+    void hardwareLoop();
+    void moveLoop();
+    void publishLoop();
+    void hardwareError(const vpRobotException &e, vpROSRobotNodeError &error);
+    void publish(const State &state);
+    void stop();
+    static void waitPeriod(struct timespec &deadline, double period, vpROSRobotNodeLoopStats &stats);
+
+    ros::NodeHandle n;
+    ros::Publisher pose_pub;
+    ros::Publisher vel_pub;
+    ros::Publisher joint_pub;
+    ros::Subscriber cmd_vel_sub;
+    ros::Subscriber cmd_pos_sub;
+
+    RobotT *robot;
+    typename Traits::Scratch scratch; //!< Buffers of Traits::read(), only used by the hardware thread.
+    boost::thread *hw_thread;
+    boost::thread *pub_thread;
+    boost::thread *move_thread;
+    boost::atomic<bool> running;
+    int _hw_priority;
+    double _rate;
+    double _hw_rate;
+    int _queue_size;
+
+    vpROSSeqLock<vpROSRobotNodeLoopStats> hw_stats;  //!< Written by the hardware thread.
+    vpROSSeqLock<vpROSRobotNodeLoopStats> pub_stats; //!< Written by the publishing thread.
+
+    vpROSSeqLock<State> state_lock; //!< Last state read by the hardware thread.
+    Command command;                //!< Last received command, written by the callbacks only.
+    vpROSSeqLock<Command> cmd_lock; //!< Last received command, for the hardware thread.
+    vpROSSeqLock<vpROSRobotNodeError> error_lock; //!< Written by the hardware thread.
+
+    sem_t move_sem;                //!< Posted by the hardware thread for each blocking position command.
+    boost::atomic<bool> moving;    //!< True while a blocking position command runs.
+    double move_q[Traits::njoints]; //!< Target of the blocking position command, written when not moving.
+
+    geometry_msgs::PoseStamped pose_msg;  //!< Preallocated pose message.
+    geometry_msgs::TwistStamped vel_msg;  //!< Preallocated velocity message.
+    sensor_msgs::JointState joint_msg;    //!< Preallocated joint state message.
+
+  private:
+    vpROSRobotNode(const vpROSRobotNode &);
+    vpROSRobotNode &operator=(const vpROSRobotNode &);
+};
+
+/*!
+  Constructor. Reads the parameters, advertises the state topics and
+  subscribes to the command topics.
+
+  \param nh : Node handle, usually the private one.
+*/
+template<class RobotT, class Traits>
+vpROSRobotNode<RobotT, Traits>::vpROSRobotNode(ros::NodeHandle nh) :
+  n(nh),
+  robot(NULL),
+  hw_thread(NULL),
+  pub_thread(NULL),
+  move_thread(NULL),
+  running(false),
+  _hw_priority(0),
+  moving(false)
+{
+  ROS_INFO( "Using %s robot", Traits::name() );
+  memset(&command, 0, sizeof(command));
+  memset(move_q, 0, sizeof(move_q));
+  sem_init(&move_sem, 0, 0);
+
+  n.param("rate", _rate, Traits::rate());
+  n.param("hardware_rate", _hw_rate, Traits::hardwareRate());
+  n.param("queue_size", _queue_size, 10);
+  if(_rate <= 0.){
+    ROS_WARN("%s: invalid rate %f, using %f", Traits::name(), _rate, Traits::rate());
+    _rate = Traits::rate();
+  }
+  if(_hw_rate <= 0.){
+    ROS_WARN("%s: invalid hardware_rate %f, using %f", Traits::name(), _hw_rate, Traits::hardwareRate());
+    _hw_rate = Traits::hardwareRate();
+  }
+  if(_queue_size < 1)
+    _queue_size = 1;
+  unsigned int queue_size = (unsigned int)_queue_size;
+
+  pose_pub = n.advertise<geometry_msgs::PoseStamped>(Traits::poseTopic(), queue_size);
+  if(Traits::velocityTopic())
+    vel_pub = n.advertise<geometry_msgs::TwistStamped>(Traits::velocityTopic(), queue_size);
+  if(Traits::jointStateTopic()){
+    joint_pub = n.advertise<sensor_msgs::JointState>(Traits::jointStateTopic(), queue_size);
+    joint_msg.name.resize(Traits::njoints);
+    joint_msg.position.resize(Traits::njoints);
+    joint_msg.velocity.resize(Traits::njoints);
+    for(unsigned int i = 0; i < Traits::njoints; i++)
+      joint_msg.name[i] = Traits::jointName(i);
+  }
+
+  cmd_vel_sub = n.subscribe( Traits::velocityCommandTopic(), 1, (boost::function < void(const typename Traits::VelocityMsg::ConstPtr&)>) boost::bind( &vpROSRobotNode::velocityCallback, this, _1 ));
+  if(Traits::positionCommandTopic())
+    cmd_pos_sub = n.subscribe( Traits::positionCommandTopic(), 1, (boost::function < void(const typename Traits::PositionMsg::ConstPtr&)>) boost::bind( &vpROSRobotNode::positionCallback, this, _1 ));
+}
+
+/*!
+  Destructor. Stops the threads and the robot.
+*/
+template<class RobotT, class Traits>
+vpROSRobotNode<RobotT, Traits>::~vpROSRobotNode()
+{
+  stop();
+  if (robot) {
+    robot->stopMotion();
+    delete robot;
+    robot = NULL;
+  }
+  sem_destroy(&move_sem);
+}
+
+/*!
+  Set the real-time priority of the hardware thread. To call before setup().
+
+  \param priority : SCHED_FIFO priority (1 to 99). 0 keeps the default
+  scheduling policy. Raising the priority usually requires the CAP_SYS_NICE
+  capability; a failure is reported as a ROS warning.
+*/
+template<class RobotT, class Traits>
+void vpROSRobotNode<RobotT, Traits>::setHardwarePriority(int priority)
+{
+  _hw_priority = priority;
+}
+
+/*!
+  Create the robot and start the hardware and publishing threads.
+
+  \return 0 on success.
+*/
+template<class RobotT, class Traits>
+int vpROSRobotNode<RobotT, Traits>::setup()
+{
+  robot = Traits::create(scratch);
+  if(robot == NULL)
+    return -1;
+  running.store(true, boost::memory_order_release);
+  if(Traits::blockingPosition() && Traits::positionCommandTopic())
+    move_thread = new boost::thread(boost::bind(&vpROSRobotNode::moveLoop, this));
+  hw_thread = new boost::thread(boost::bind(&vpROSRobotNode::hardwareLoop, this));
+  pub_thread = new boost::thread(boost::bind(&vpROSRobotNode::publishLoop, this));
+  return 0;
+}
+
+/*!
+  Process the commands until ROS shuts down.
+*/
+template<class RobotT, class Traits>
+void vpROSRobotNode<RobotT, Traits>::spin()
+{
+  ros::spin();
+  stop();
+}
+
+template<class RobotT, class Traits>
+void vpROSRobotNode<RobotT, Traits>::stop()
+{
+  if(!hw_thread)
+    return;
+  running.store(false, boost::memory_order_release);
+  pub_thread->join();
+  delete pub_thread;
+  pub_thread = NULL;
+  hw_thread->join();
+  delete hw_thread;
+  hw_thread = NULL;
+  if(move_thread){
+    // Waits for the end of the motion in progress
+    sem_post(&move_sem);
+    move_thread->join();
+    delete move_thread;
+    move_thread = NULL;
+  }
+
+  vpROSRobotNodeLoopStats hw = hw_stats.load(), pub = pub_stats.load();
+  ROS_INFO("%s: hardware loop %lu cycles, %lu overruns (%lu periods missed, max %.3f ms late)",
+           Traits::name(), hw.cycles, hw.overruns, hw.missed, hw.late_max * 1000.);
+  ROS_INFO("%s: publishing loop %lu cycles, %lu overruns (%lu periods missed, max %.3f ms late), %lu states skipped",
+           Traits::name(), pub.cycles, pub.overruns, pub.missed, pub.late_max * 1000., pub.skipped);
+}
+
+/*!
+  Sleep until the next period of a loop. A late loop skips the periods it
+  missed and sleeps until the next period boundary, instead of running a
+  burst of iterations to catch up or starting the next one at once, which
+  would keep a real-time thread busy and starve the other threads.
+
+  \param deadline : Start of the current period, updated to the start of the next one.
+  \param period : Period of the loop in seconds.
+  \param stats : Statistics of the loop, updated.
+*/
+template<class RobotT, class Traits>
+void vpROSRobotNode<RobotT, Traits>::waitPeriod(struct timespec &deadline, double period, vpROSRobotNodeLoopStats &stats)
+{
+  const long period_ns = (long)(period * 1000000000.0);
+  deadline.tv_nsec += period_ns;
+  while(deadline.tv_nsec >= 1000000000L){
+    deadline.tv_nsec -= 1000000000L;
+    deadline.tv_sec++;
+  }
+  stats.cycles++;
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  double late = (double)(now.tv_sec - deadline.tv_sec) + (double)(now.tv_nsec - deadline.tv_nsec) / 1000000000.0;
+  if(late > 0.){
+    stats.overruns++;
+    if(late > stats.late_max)
+      stats.late_max = late;
+    unsigned long missed = (unsigned long)(late / period) + 1;
+    stats.missed += missed;
+    long long ns = (long long)deadline.tv_nsec + (long long)missed * period_ns;
+    deadline.tv_sec += (time_t)(ns / 1000000000LL);
+    deadline.tv_nsec = (long)(ns % 1000000000LL);
+  }
+  while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR);
+}
+
+template<class RobotT, class Traits>
+void vpROSRobotNode<RobotT, Traits>::velocityCallback(const typename Traits::VelocityMsg::ConstPtr &msg)
+{
+  Traits::velocity(*msg, command.v);
+  command.type = Command::VELOCITY;
+  command.seq++;
+  cmd_lock.store(command);
+}
+
+template<class RobotT, class Traits>
+void vpROSRobotNode<RobotT, Traits>::positionCallback(const typename Traits::PositionMsg::ConstPtr &msg)
+{
+  Traits::position(*msg, command.v);
+  command.type = Command::POSITION;
+  command.seq++;
+  cmd_lock.store(command);
+}
+
+template<class RobotT, class Traits>
+void vpROSRobotNode<RobotT, Traits>::hardwareLoop()
+{
+  if(_hw_priority > 0){
+    struct sched_param param;
+    param.sched_priority = _hw_priority;
+    if(pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0)
+      ROS_WARN("%s: cannot set the hardware thread priority to %d", Traits::name(), _hw_priority);
+  }
+
+  const double period = 1. / _hw_rate;
+  vpROSRobotNodeLoopStats stats;
+  memset(&stats, 0, sizeof(stats));
+  unsigned long applied = 0;
+  Command c;
+  State s;
+  memset(&s, 0, sizeof(s));
+  vpColVector v(Traits::velocityFrame() == vpRobot::ARTICULAR_FRAME ? Traits::njoints : 6);
+  vpColVector q(Traits::njoints);
+  vpROSRobotNodeError error;
+  memset(&error, 0, sizeof(error));
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+  while(running.load(boost::memory_order_acquire)){
+    // The callbacks have a lower priority: never spin on their seqlock, a
+    // command being written is picked up at the next period. The commands
+    // are held during a blocking motion.
+    if(!moving.load(boost::memory_order_acquire) && cmd_lock.tryLoad(c) && c.seq != applied){
+      applied = c.seq;
+      try{
+        if(c.type == Command::VELOCITY){
+          for(unsigned int i = 0; i < v.getRows(); i++)
+            v[i] = c.v[i];
+          robot->setRobotState(vpRobot::STATE_VELOCITY_CONTROL);
+          robot->setVelocity(Traits::velocityFrame(), v);
+        }
+        else if(c.type == Command::POSITION && move_thread){
+          memcpy(move_q, c.v, sizeof(move_q));
+          moving.store(true, boost::memory_order_release);
+          sem_post(&move_sem);
+        }
+        else if(c.type == Command::POSITION){
+          for(unsigned int i = 0; i < q.getRows(); i++)
+            q[i] = c.v[i];
+          robot->setRobotState(vpRobot::STATE_POSITION_CONTROL);
+          robot->setPosition(vpRobot::ARTICULAR_FRAME, q);
+        }
+      }
+      catch(const vpRobotException &e){
+        hardwareError(e, error);
+      }
+    }
+
+    try{
+      Traits::read(*robot, scratch, s);
+      s.seq++;
+      state_lock.store(s);
+    }
+    catch(const vpRobotException &e){
+      hardwareError(e, error);
+    }
+
+    waitPeriod(deadline, period, stats);
+    hw_stats.store(stats);
+  }
+}
+
+/*
+  Record an exception caught by the hardware thread for the publishing
+  thread, and stop the robot. No allocation nor logging here.
+*/
+template<class RobotT, class Traits>
+void vpROSRobotNode<RobotT, Traits>::hardwareError(const vpRobotException &e, vpROSRobotNodeError &error)
+{
+  strncpy(error.message, e.what(), sizeof(error.message) - 1);
+  error.message[sizeof(error.message) - 1] = '\0';
+  error.count++;
+  error_lock.store(error);
+  try{
+    robot->stopMotion();
+  }
+  catch(const vpRobotException &){
+  }
+}
+
+/*
+  Apply the blocking position commands posted by the hardware thread.
+*/
+template<class RobotT, class Traits>
+void vpROSRobotNode<RobotT, Traits>::moveLoop()
+{
+  vpColVector q(Traits::njoints);
+  for(;;){
+    while(sem_wait(&move_sem) != 0 && errno == EINTR);
+    if(!running.load(boost::memory_order_acquire))
+      break;
+    for(unsigned int i = 0; i < q.getRows(); i++)
+      q[i] = move_q[i];
+    try{
+      robot->setRobotState(vpRobot::STATE_POSITION_CONTROL);
+      robot->setPosition(vpRobot::ARTICULAR_FRAME, q);
+    }
+    catch(const vpRobotException &e){
+      ROS_ERROR("%s: position command failed: %s", Traits::name(), e.what());
+      try{
+        robot->stopMotion();
+      }
+      catch(const vpRobotException &){
+      }
+    }
+    moving.store(false, boost::memory_order_release);
+  }
+}
+
+template<class RobotT, class Traits>
+void vpROSRobotNode<RobotT, Traits>::publishLoop()
+{
+  const double period = 1. / _rate;
+  // States read by a faster hardware thread within one period are skipped by design
+  const unsigned long decimation = (unsigned long)ceil(_hw_rate / _rate);
+  vpROSRobotNodeLoopStats stats;
+  memset(&stats, 0, sizeof(stats));
+  unsigned long published = 0;
+  State s;
+  unsigned int logged = 0;
+  vpROSRobotNodeError error;
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+  while(running.load(boost::memory_order_acquire) && ros::ok()){
+    if(error_lock.version() != logged){
+      logged = error_lock.version();
+      error_lock.load(error);
+      ROS_ERROR_THROTTLE(1., "%s: %s, robot stopped (%lu errors)", Traits::name(), error.message, error.count);
+    }
+
+    state_lock.load(s);
+    if(s.seq != published){
+      if(published != 0 && s.seq - published > decimation)
+        stats.skipped += s.seq - published - decimation;
+      publish(s);
+      published = s.seq;
+    }
+
+    waitPeriod(deadline, period, stats);
+    pub_stats.store(stats);
+  }
+}
+template<class RobotT, class Traits>
+void vpROSRobotNode<RobotT, Traits>::publish(const State &s)
+{
+  pose_msg.header.stamp = ros::Time(s.stamp);
+  pose_msg.pose.position.x = s.pose[0];
+  pose_msg.pose.position.y = s.pose[1];
+  pose_msg.pose.position.z = s.pose[2];
+  pose_msg.pose.orientation.x = s.pose[3];
+  pose_msg.pose.orientation.y = s.pose[4];
+  pose_msg.pose.orientation.z = s.pose[5];
+  pose_msg.pose.orientation.w = s.pose[6];
+  pose_pub.publish(pose_msg);
+
+  if(Traits::velocityTopic()){
+    vel_msg.header.stamp = pose_msg.header.stamp;
+    vel_msg.twist.linear.x = s.twist[0];
+    vel_msg.twist.linear.y = s.twist[1];
+    vel_msg.twist.linear.z = s.twist[2];
+    vel_msg.twist.angular.x = s.twist[3];
+    vel_msg.twist.angular.y = s.twist[4];
+    vel_msg.twist.angular.z = s.twist[5];
+    vel_pub.publish(vel_msg);
+  }
+
+  if(Traits::jointStateTopic()){
+    joint_msg.header.stamp = pose_msg.header.stamp;
+    for(unsigned int i = 0; i < Traits::njoints; i++){
+      joint_msg.position[i] = s.q[i];
+      joint_msg.velocity[i] = s.qdot[i];
+    }
+    joint_pub.publish(joint_msg);
+  }
+}
+
+#endif
@@ -44,7 +44,14 @@
 #include <visp/vpConfig.h>
 #include <visp/vpRobot.h>
 #include <visp_ros/vpROSRobot.h>
+#include <visp_ros/vpROSObstacleGrid.h>
 #include <visp/vpPioneer.h>
+#include <sensor_msgs/LaserScan.h>
+#include <sensor_msgs/PointCloud.h>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <string>
+#include <vector>
 
 /*!
 
@@ -69,7 +76,19 @@ private: /* Not allowed functions. */
   vpROSRobotPioneer(const vpROSRobotPioneer &robot);
 
 public:
+  /*!
+    Closest obstacle seen by the range sensors, see getNearestObstacle().
+  */
+  struct vpROSNearestObstacle
+  {
+    double distance;    //!< Distance to the robot origin in meters.
+    double x, y;        //!< Position in the robot frame.
+    uint32_t sec, nsec; //!< Stamp of the scan.
+    int valid;          //!< 0 if the sensor did not see any obstacle yet.
+  };
+
   vpROSRobotPioneer();
+  virtual ~vpROSRobotPioneer();
 
   /*!
     Get the robot Jacobian expressed at point E, the point located at the
@@ -95,35 +114,69 @@ private: // Set as private since not implemented
   void get_fJe(vpMatrix & /*fJe*/) {} ;
 
 public:
-  void getVelocity (const vpRobot::vpControlFrameType frame, vpColVector & velocity)  
-  {
-	throw (vpRobotException(vpRobotException::notImplementedError, "getVelocity not implemented with ROS") );
-  }
-  vpColVector getVelocity (const vpRobot::vpControlFrameType frame)
-  {
-	throw (vpRobotException(vpRobotException::notImplementedError, "getVelocity not implemented with ROS") );
-  }
-
-private: // Set as private since not implemented
-  /*!
-    Set a displacement (frame has to be specified) in position control.
-    \warning Not implemented.
-  */
-  void setPosition(const vpRobot::vpControlFrameType /*frame*/, const vpColVector &/*q*/) {};
+  void getVelocity (const vpRobot::vpControlFrameType frame, vpColVector & velocity);
+  vpColVector getVelocity (const vpRobot::vpControlFrameType frame);
+  void set_cMe(const vpHomogeneousMatrix &cMe);
 
 public:
   void setVelocity(const vpRobot::vpControlFrameType frame, const vpColVector &vel);
+  void setVelocity(const vpRobot::vpControlFrameType frame, const vpColVector &vel, const struct timespec &timestamp);
+
+  void useSonar(bool usage);
+  void useLaser(bool usage, const std::string &topic = "scan");
+  void setLaserPose(double x, double y, double theta);
+
+  bool getNearestObstacle(double &distance, double &x, double &y);
+  void getObstacles(std::vector<float> &x, std::vector<float> &y);
+
+  void setSafety(bool enable, double stop_distance = 0.1, double slow_distance = 0.5);
+  void setRobotRadius(double radius);
+  //! Get the scale applied to the last command by the safety layer, 1 when not limited.
+  double getSafetyScale() const { return _safety_scale.load(); }
 
+protected:
   /*!
-    Enable or disable sonar device usage.
-    */
-  void useSonar(bool usage)
+    Nearest obstacles of both range sensors, published through a sequence lock.
+  */
+  struct vpROSObstacleState
   {
-	throw (vpRobotException(vpRobotException::notImplementedError, "useSonar not implemented with ROS") );
-  }
+    vpROSNearestObstacle laser;
+    vpROSNearestObstacle sonar;
+    double ahead[2];  //!< Distance of the nearest laser (0) and sonar (1) obstacle with x >= 0.
+    double behind[2]; //!< Distance of the nearest laser (0) and sonar (1) obstacle with x < 0.
+  };
+
+  void initCommunication();
+  void applyControllerVelocity(double v, double w);
+  void subscribeSensors();
+  void laserCallback(const sensor_msgs::LaserScan::ConstPtr &msg);
+  void sonarCallback(const sensor_msgs::PointCloud::ConstPtr &msg);
+  void updateLaserTables(const sensor_msgs::LaserScan &msg);
+  double safetyScale(double v, double w);
 
-protected:
   bool isInitialized;
+
+  ros::Subscriber laser_sub;
+  ros::Subscriber sonar_sub;
+  bool _use_laser;
+  bool _use_sonar;
+  std::string _topic_laser;
+  std::string _topic_sonar;
+  double _laser_pose[3]; //!< Laser position and orientation in the robot frame.
+
+  boost::mutex sensor_mutex;            //!< Serializes the sensor callbacks and the buffer copies.
+  vpROSObstacleState obstacle_state;    //!< Written under sensor_mutex.
+  vpROSSeqLock<vpROSObstacleState> obstacle_lock;
+  std::vector<float> laser_cos, laser_sin; //!< Direction of each beam in the robot frame.
+  float laser_angle_min, laser_angle_increment;
+  std::vector<float> laser_x, laser_y;  //!< Laser points in the robot frame.
+  std::vector<float> sonar_x, sonar_y;  //!< Sonar points in the robot frame.
+
+  vpROSObstacleGrid grid;               //!< Inflated laser and sonar points, updated under sensor_mutex.
+  bool _safety;
+  double _safety_stop;
+  double _safety_slow;
+  boost::atomic<double> _safety_scale; //!< Written by setVelocity(), also from the odometry thread.
 };
 
 #endif // vpROSRobotPioneer_H
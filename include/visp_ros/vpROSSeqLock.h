@@ -0,0 +1,146 @@
+/****************************************************************************
+ *
+ * $Id: vpROSSeqLock.h $
+ *
+ * This file is part of the ViSP software.
+ * Copyright (C) 2005 - 2014 by INRIA. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact INRIA about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://www.irisa.fr/lagadic/visp/visp.html for more information.
+ *
+ * This software was developed at:
+ * INRIA Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ * http://www.irisa.fr/lagadic
+ *
+ * If you have questions regarding the use of this file, please contact
+ * INRIA at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *
+ * Description:
+ * Single writer sequence lock.
+ *
+ * Authors:
+ * agent
+ *
+ *****************************************************************************/
+
+/*!
+  \file vpROSSeqLock.h
+  \brief Single writer sequence lock used to share small states between threads.
+*/
+
+#ifndef vpROSSeqLock_h
+#define vpROSSeqLock_h
+
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+#include <cstring>
+
+/*!
+  \class vpROSSeqLock
+
+  \brief Sequence lock protecting a plain old data value.
+
+  One thread publishes new values with store() while any number of threads
+  read consistent snapshots with load(). The writer never waits for the
+  readers; a reader retries when the value was modified while it was being
+  copied, so it never sees a torn value.
+
+  \warning T has to be a plain old data type (copied with memcpy), and
+  store() must not be called concurrently from several threads.
+*/
+template<class T>
+class vpROSSeqLock
+{
+  public:
+    vpROSSeqLock() : seq_(0)
+    {
+      std::memset(&value_, 0, sizeof(T));
+    }
+
+    explicit vpROSSeqLock(const T &value) : seq_(0)
+    {
+      std::memcpy(&value_, &value, sizeof(T));
+    }
+
+    //! Publish a new value. Single writer only.
+    void store(const T &value)
+    {
+      unsigned int s = seq_.load(boost::memory_order_relaxed);
+      seq_.store(s + 1, boost::memory_order_relaxed);
+      boost::atomic_thread_fence(boost::memory_order_release);
+      std::memcpy(&value_, &value, sizeof(T));
+      seq_.store(s + 2, boost::memory_order_release);
+    }
+
+    //! Get a consistent copy of the last published value.
+    void load(T &value) const
+    {
+      for(;;){
+        unsigned int s1 = seq_.load(boost::memory_order_acquire);
+        if(s1 & 1){
+          boost::this_thread::yield();
+          continue;
+        }
+        std::memcpy(&value, &value_, sizeof(T));
+        boost::atomic_thread_fence(boost::memory_order_acquire);
+        unsigned int s2 = seq_.load(boost::memory_order_relaxed);
+        if(s1 == s2)
+          return;
+      }
+    }
+
+    /*!
+      Try once to get a consistent copy of the last published value, without
+      waiting for the writer. To use from a thread with a higher real-time
+      priority than the writer, which a spinning load() could starve.
+      \return false if the value was being modified; \e value is then undefined.
+    */
+    bool tryLoad(T &value) const
+    {
+      unsigned int s1 = seq_.load(boost::memory_order_acquire);
+      if(s1 & 1)
+        return false;
+      std::memcpy(&value, &value_, sizeof(T));
+      boost::atomic_thread_fence(boost::memory_order_acquire);
+      return seq_.load(boost::memory_order_relaxed) == s1;
+    }
+
+    //! Get a consistent copy of the last published value.
+    T load() const
+    {
+      T value;
+      load(value);
+      return value;
+    }
+
+    //! Number of values published so far.
+    unsigned int version() const
+    {
+      return seq_.load(boost::memory_order_acquire) / 2;
+    }
+
+  private:
+    vpROSSeqLock(const vpROSSeqLock &);
+    vpROSSeqLock &operator=(const vpROSSeqLock &);
+
+    boost::atomic<unsigned int> seq_;
+    T value_;
+};
+
+#endif
@@ -0,0 +1,166 @@
+/****************************************************************************
+ *
+ * $Id: vpROSSimulatedBase.h $
+ *
+ * This file is part of the ViSP software.
+ * Copyright (C) 2005 - 2014 by INRIA. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact INRIA about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://www.irisa.fr/lagadic/visp/visp.html for more information.
+ *
+ * This software was developed at:
+ * INRIA Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ * http://www.irisa.fr/lagadic
+ *
+ * If you have questions regarding the use of this file, please contact
+ * INRIA at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *
+ * Description:
+ * Simulated mobile base publishing odometry from velocity commands.
+ *
+ * Authors:
+ * agent
+ *
+ *****************************************************************************/
+
+/*!
+  \file vpROSSimulatedBase.h
+  \brief Simulated mobile base publishing odometry from velocity commands.
+*/
+
+#ifndef vpROSSimulatedBase_h
+#define vpROSSimulatedBase_h
+
+#include <visp/vpConfig.h>
+#include <visp/vpNoise.h>
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <geometry_msgs/Twist.h>
+#include <geometry_msgs/TwistStamped.h>
+#include <nav_msgs/Odometry.h>
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <deque>
+#include <string>
+
+/*!
+  \class vpROSSimulatedBase
+
+  \brief Kinematic simulation of a mobile base driven through ROS.
+
+  The base subscribes to a geometry_msgs::Twist command topic, or to a
+  geometry_msgs::TwistStamped one to match vpROSRobot::setCommandStamped(),
+  integrates a unicycle or holonomic model at a fixed rate and publishes nav_msgs::Odometry
+  as a real base driver would. The command latency and the odometry rate and
+  noise can be configured, so that vpROSRobot based control loops can be run
+  and benchmarked without hardware, either in the same process or through
+  the visp_ros_simulated_base_node.
+
+  \code
+vpROSSimulatedBase base;
+base.setRate(50);
+base.setLatency(0.04);
+base.start(); // Requires ros::init() and a running master
+
+vpROSRobotPioneer robot;
+robot.init(argc, argv);
+...
+double x, y, theta;
+base.getPose(x, y, theta); // Ground truth
+  \endcode
+*/
+class VISP_EXPORT vpROSSimulatedBase
+{
+  public:
+    /*!
+      Kinematic model of the simulated base.
+    */
+    typedef enum {
+      UNICYCLE,  //!< Differential drive: only vx and wz are applied.
+      HOLONOMIC  //!< Omnidirectional: vx, vy and wz are applied.
+    } vpBaseModel;
+
+    vpROSSimulatedBase();
+    virtual ~vpROSSimulatedBase();
+
+    void start();
+    void stop();
+    bool isRunning() const { return running; }
+
+    /*! Set the kinematic model. \param model : Model of the base. */
+    void setModel(vpBaseModel model) { _model = model; }
+    void setRate(double hz);
+    void setLatency(double latency);
+    void setNoise(double linear, double angular);
+    void setCommandStamped(bool stamped);
+    /*! Set the namespace of the topics. \param nodespace : Namespace, ending with a '/'. */
+    void setNodespace(const std::string &nodespace) { _nodespace = nodespace; }
+    /*! Set the velocity command topic. \param topic : Topic name, "cmd_vel" by default. */
+    void setCmdVelTopic(const std::string &topic) { _topic_cmd = topic; }
+    /*! Set the odometry topic. \param topic : Topic name, "odom" by default. */
+    void setOdomTopic(const std::string &topic) { _topic_odom = topic; }
+
+    void getPose(double &x, double &y, double &theta);
+    void setPose(double x, double y, double theta);
+
+  protected:
+    struct Command
+    {
+      double t;     //!< Monotonic time (s) at which the command is applied.
+      double v[3];  //!< vx, vy, wz.
+    };
+
+    void cmdCallback(const geometry_msgs::Twist::ConstPtr &msg);
+    void cmdStampedCallback(const geometry_msgs::TwistStamped::ConstPtr &msg);
+    void pushCommand(const geometry_msgs::Twist &twist);
+    void loop();
+
+    ros::CallbackQueue queue;
+    ros::NodeHandle *n;
+    ros::Subscriber cmd_sub;
+    ros::Publisher odom_pub;
+    boost::thread *thread;
+    boost::atomic<bool> running;
+
+    std::deque<Command> commands; //!< Commands waiting for their latency to elapse.
+
+    boost::mutex pose_mutex;
+    double pose[3];      //!< Ground truth x, y, theta.
+    double odom_pose[3]; //!< Pose integrated from the noisy odometry twist.
+
+    vpGaussRand noise_linear;
+    vpGaussRand noise_angular;
+
+    vpBaseModel _model;
+    double _rate;
+    double _latency;
+    double _noise_linear;
+    double _noise_angular;
+    bool _cmd_stamped;
+    std::string _nodespace;
+    std::string _topic_cmd;
+    std::string _topic_odom;
+
+  private:
+    vpROSSimulatedBase(const vpROSSimulatedBase &);
+    vpROSSimulatedBase &operator=(const vpROSSimulatedBase &);
+};
+
+#endif
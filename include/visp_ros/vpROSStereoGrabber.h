@@ -0,0 +1,193 @@
+/****************************************************************************
+ *
+ * $Id: vpROSStereoGrabber.h $
+ *
+ * This file is part of the ViSP software.
+ * Copyright (C) 2005 - 2014 by INRIA. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact INRIA about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://www.irisa.fr/lagadic/visp/visp.html for more information.
+ *
+ * This software was developed at:
+ * INRIA Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ * http://www.irisa.fr/lagadic
+ *
+ * If you have questions regarding the use of this file, please contact
+ * INRIA at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *
+ * Description:
+ * Stereo camera video capture for ROS middleware.
+ *
+ * Authors:
+ * agent
+ *
+ *****************************************************************************/
+
+/*!
+  \file vpROSStereoGrabber.h
+  \brief class for stereo camera video capture for ROS middleware.
+*/
+
+#ifndef vpROSStereoGrabber_h
+#define vpROSStereoGrabber_h
+
+#include <visp/vpConfig.h>
+
+#if defined(VISP_HAVE_OPENCV)
+
+#include <visp/vpImage.h>
+#include <visp/vpRGBa.h>
+#include <visp/vpCameraParameters.h>
+#include <ros/ros.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/CameraInfo.h>
+#include <message_filters/subscriber.h>
+#include <message_filters/synchronizer.h>
+#include <message_filters/sync_policies/approximate_time.h>
+#include <image_geometry/stereo_camera_model.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#if VISP_HAVE_OPENCV_VERSION >= 0x020101
+#  include <opencv2/imgproc/imgproc.hpp>
+#else
+#  include <cv.h>
+#endif
+
+/*!
+  \class vpROSStereoGrabber
+
+  \ingroup Framegrabber CameraDriver
+
+  \brief Class for stereo cameras video capture for ROS cameras.
+
+  Left and right images are time synchronized and rectified with the
+  stereo model built from both CameraInfo messages (R and P matrices).
+  The rectification maps are computed once for the binning and the region
+  of interest given in the CameraInfo, and cached until the calibration
+  changes. Both images are remapped in parallel. The returned images are
+  row-aligned and can be given directly to a block matching algorithm.
+  While rectification is enabled, the pairs received before both CameraInfo
+  are never returned.
+
+  Only the raw image transport is supported.
+
+  The code below shows how to use this class.
+  \code
+#include <visp/vpImage.h>
+#include <visp_ros/vpROSStereoGrabber.h>
+
+int main()
+{
+#if defined(VISP_HAVE_OPENCV)
+  vpImage<unsigned char> Il, Ir;
+  vpROSStereoGrabber g;
+
+  g.setNodespace("/stereo/");
+  g.open();
+  g.acquire(Il, Ir);
+#endif
+}
+  \endcode
+
+ */
+class VISP_EXPORT vpROSStereoGrabber
+{
+  protected:
+    typedef message_filters::sync_policies::ApproximateTime<sensor_msgs::Image, sensor_msgs::Image> SyncPolicy;
+
+    ros::NodeHandle *n;
+    message_filters::Subscriber<sensor_msgs::Image> *left_data;
+    message_filters::Subscriber<sensor_msgs::Image> *right_data;
+    message_filters::Synchronizer<SyncPolicy> *sync;
+    ros::Subscriber left_info;
+    ros::Subscriber right_info;
+    ros::AsyncSpinner *spinner;
+    volatile bool isInitialized;
+    volatile unsigned short usWidth;
+    volatile unsigned short usHeight;
+    image_geometry::StereoCameraModel model;
+    sensor_msgs::CameraInfo left_info_msg, right_info_msg;
+    bool left_info_received, right_info_received;
+    cv::Mat map1[2], map2[2];
+    cv::Matx34d rect_P[2];
+    bool maps_valid;
+    cv::Mat data[2];
+    cv::Mat rect[2];
+    bool flip;
+    volatile bool _rectify;
+    boost::mutex mutex_image, mutex_param;
+    boost::condition_variable cond_image, cond_param;
+    bool first_img_received, first_param_received;
+    uint32_t _sec, _nsec;
+    std::string _master_uri;
+    std::string _topic_left_image;
+    std::string _topic_left_info;
+    std::string _topic_right_image;
+    std::string _topic_right_info;
+    std::string _nodespace;
+    unsigned int _sync_queue_size;
+
+    void imageCallback(const sensor_msgs::Image::ConstPtr& left, const sensor_msgs::Image::ConstPtr& right);
+    void leftParamCallback(const sensor_msgs::CameraInfo::ConstPtr& msg);
+    void rightParamCallback(const sensor_msgs::CameraInfo::ConstPtr& msg);
+    void updateModel();
+    template<class Image> bool grab(Image &Il, Image &Ir, struct timespec &timestamp, bool wait);
+
+  public:
+
+    vpROSStereoGrabber();
+    virtual ~vpROSStereoGrabber();
+
+    void open(int argc, char **argv);
+    void open();
+
+    void acquire(vpImage<unsigned char> &Il, vpImage<unsigned char> &Ir);
+    void acquire(vpImage<vpRGBa> &Il, vpImage<vpRGBa> &Ir);
+    void acquire(cv::Mat &Il, cv::Mat &Ir);
+    bool acquireNoWait(vpImage<unsigned char> &Il, vpImage<unsigned char> &Ir);
+    bool acquireNoWait(vpImage<vpRGBa> &Il, vpImage<vpRGBa> &Ir);
+
+    void acquire(vpImage<unsigned char> &Il, vpImage<unsigned char> &Ir, struct timespec &timestamp);
+    void acquire(vpImage<vpRGBa> &Il, vpImage<vpRGBa> &Ir, struct timespec &timestamp);
+    void acquire(cv::Mat &Il, cv::Mat &Ir, struct timespec &timestamp);
+    bool acquireNoWait(vpImage<unsigned char> &Il, vpImage<unsigned char> &Ir, struct timespec &timestamp);
+    bool acquireNoWait(vpImage<vpRGBa> &Il, vpImage<vpRGBa> &Ir, struct timespec &timestamp);
+
+    void close();
+
+    void setLeftImageTopic(std::string topic_name);
+    void setLeftCameraInfoTopic(std::string topic_name);
+    void setRightImageTopic(std::string topic_name);
+    void setRightCameraInfoTopic(std::string topic_name);
+    void setMasterURI(std::string master_uri);
+    void setNodespace(std::string nodespace);
+    void setSyncQueueSize(unsigned int queue_size);
+    void setFlip(bool flipType);
+    void setRectify(bool rectify);
+
+    void getCameraInfo(vpCameraParameters &cam_left, vpCameraParameters &cam_right);
+    double getBaseline();
+    void getReprojectionMatrix(cv::Mat &Q);
+    unsigned short getWidth() const;
+    unsigned short getHeight() const;
+};
+
+#endif
+#endif
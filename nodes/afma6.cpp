@@ -1,175 +1,159 @@
 #include <stdio.h>
 #include <math.h>
-#include <sstream>
 
 #include <ros/ros.h>
 #include <geometry_msgs/TwistStamped.h>
 #include <geometry_msgs/Pose.h>
 #include <geometry_msgs/PoseStamped.h>
-#include <nav_msgs/Odometry.h>
-#include <tf/tf.h>
-#include <tf/transform_listener.h>
-#include <tf/transform_broadcaster.h>
-#include <tf/transform_datatypes.h>
+#include <sensor_msgs/JointState.h>
 
 #include <visp/vpRobotAfma6.h> // visp
 #include <visp/vpRingLight.h>
+#include <visp/vpMatrix.h>
+#include <visp/vpHomogeneousMatrix.h>
+#include <visp/vpVelocityTwistMatrix.h>
 
-#include <visp_bridge/3dpose.h> // visp_bridge
-
+#include <visp_ros/vpROSRobotNode.h>
 
 #ifdef VISP_HAVE_AFMA6
 
-class RosAfma6Node
-{
-  public:
-    RosAfma6Node(ros::NodeHandle n);
-    virtual ~RosAfma6Node();
-    
-  public:
-    int setup();
-    void setCameraVel( const geometry_msgs::TwistStampedConstPtr &);
-    void spin();
-    void publish();
- 
-  protected:
-    ros::NodeHandle n;
-    ros::Publisher pose_pub;
-    ros::Publisher vel_pub;
-    ros::Subscriber cmd_camvel_sub;
-
-    ros::Time veltime;
-
-    std::string serial_port;
-
-    vpRobotAfma6 *robot;
-    geometry_msgs::PoseStamped position;
-    		
-    //for odom->base_link transform
-    tf::TransformBroadcaster odom_broadcaster;
-    geometry_msgs::TransformStamped odom_trans;
-    //for resolving tf names.
-    std::string tf_prefix;
-    std::string frame_id_odom;
-    std::string frame_id_base_link;
-
-    vpHomogeneousMatrix wMc; // world to camera transformation
-    vpColVector q; // measured joint position
- };
-
-
-RosAfma6Node::RosAfma6Node(ros::NodeHandle nh)
-{
-  // read in config options
-  n = nh;
-
-  ROS_INFO( "using Afma6 robot" );
-
-  robot = NULL;
-  /*
-   * Figure out what frame_id's to use. if a tf_prefix param is specified,
-   * it will be added to the beginning of the frame_ids.
-   *
-   * e.g. rosrun ... _tf_prefix:=MyRobot (or equivalently using <param>s in
-   * roslaunch files)
-   * will result in the frame_ids being set to /MyRobot/odom etc,
-   * rather than /odom. This is useful for Multi Robot Systems.
-   * See ROS Wiki for further details.
-   */
-  tf_prefix = tf::getPrefixParam(n);
-//  frame_id_odom = tf::resolve(tf_prefix, "odom");
-//  frame_id_base_link = tf::resolve(tf_prefix, "base_link");
-
-  // advertise services
-  pose_pub = n.advertise<geometry_msgs::PoseStamped>("pose", 1000);
-  vel_pub = n.advertise<geometry_msgs::TwistStamped>("velocity", 1000);
-  
-  // subscribe to services
-  cmd_camvel_sub = n.subscribe( "cmd_camvel", 1, (boost::function < void(const geometry_msgs::TwistStampedConstPtr&)>) boost::bind( &RosAfma6Node::setCameraVel, this, _1 ));
-}
-
-RosAfma6Node::~RosAfma6Node()
-{
-  if (robot) {
-    robot->stopMotion();
-    delete robot;
-    robot = NULL;
-  }
-}
-
-int RosAfma6Node::setup()
-{
-  robot = new vpRobotAfma6;
-
-  robot->init(vpAfma6::TOOL_CCMOP, vpCameraParameters::perspectiveProjWithDistortion);
-
-  robot->setRobotState(vpRobot::STATE_VELOCITY_CONTROL);
+/*!
+  Afma6 specific parts of the node: publishes the camera pose and velocity
+  and the joint states, and applies the camera velocities received on
+  "cmd_camvel".
 
-  return 0;
-}
-
-void RosAfma6Node::spin()
+  Each cycle reads the joint positions and velocities once; the camera pose
+  and velocity are derived from them with the kinematic model, so that all
+  the messages share the stamp of the joint read.
+*/
+struct vpROSAfma6Traits
 {
-	ros::Rate loop_rate(100);
-	while(ros::ok()){
-		this->publish();
-		ros::spinOnce();
-		loop_rate.sleep();
-	}
-//  ros::spin();
-}
+  enum { njoints = 6 };
+  typedef geometry_msgs::TwistStamped VelocityMsg;
+  typedef geometry_msgs::Pose PositionMsg; // Unused, no position command
 
-void RosAfma6Node::publish()
-{
-	double timestamp;
-	robot->getPosition(vpRobot::ARTICULAR_FRAME, q, timestamp);
-	wMc = robot->get_fMc(q);
-	position.pose = visp_bridge::toGeometryMsgsPose(wMc);
-	position.header.stamp = ros::Time(timestamp); // to improve: should be the timestamp returned by getPosition()
-
-	//  ROS_INFO( "Afma6 publish pose at %f s: [%0.2f %0.2f %0.2f] - [%0.2f %0.2f %0.2f %0.2f]",
-	//            position.header.stamp.toSec(),
-	//            position.pose.position.x, position.pose.position.y, position.pose.position.z,
-	//            position.pose.orientation.w, position.pose.orientation.x, position.pose.orientation.y, position.pose.orientation.z);
-	pose_pub.publish(position);
-
-	vpColVector vel(6);
-	robot->getVelocity(vpRobot::CAMERA_FRAME, vel, timestamp);
-	geometry_msgs::TwistStamped vel_msg;
-	vel_msg.header.stamp = ros::Time(timestamp);
-	vel_msg.twist.linear.x = vel[0];
-	vel_msg.twist.linear.y = vel[1];
-	vel_msg.twist.linear.z = vel[2];
-	vel_msg.twist.angular.x = vel[3];
-	vel_msg.twist.angular.y = vel[4];
-	vel_msg.twist.angular.z = vel[5];
-	vel_pub.publish(vel_msg);
-
-//	ros::Duration(1e-3).sleep();
-}
-
-void
-RosAfma6Node::setCameraVel( const geometry_msgs::TwistStampedConstPtr &msg)
-{
-  veltime = ros::Time::now();
+  // Only used by the hardware thread of one node
+  struct Scratch
+  {
+    vpVelocityTwistMatrix cVe;
+    vpHomogeneousMatrix fMc;
+    vpMatrix eJe;
+    vpColVector q, qdot;
+  };
+
+  static const char *name() { return "Afma6"; }
+  static const char *poseTopic() { return "pose"; }
+  static const char *velocityTopic() { return "velocity"; }
+  static const char *jointStateTopic() { return "joint_states"; }
+  static const char *jointName(unsigned int i)
+  {
+    static const char *names[njoints] = { "joint1", "joint2", "joint3", "joint4", "joint5", "joint6" };
+    return names[i];
+  }
+  static const char *velocityCommandTopic() { return "cmd_camvel"; }
+  static const char *positionCommandTopic() { return NULL; }
+  static vpRobot::vpControlFrameType velocityFrame() { return vpRobot::CAMERA_FRAME; }
+  static double rate() { return 100.; }
+  static double hardwareRate() { return 500.; }
+  static bool blockingPosition() { return false; }
+
+  static vpRobotAfma6 *create(Scratch &scratch)
+  {
+    vpRobotAfma6 *robot = new vpRobotAfma6;
+    robot->init(vpAfma6::TOOL_CCMOP, vpCameraParameters::perspectiveProjWithDistortion);
+    robot->setRobotState(vpRobot::STATE_VELOCITY_CONTROL);
+    // The camera to end-effector twist only depends on the tool
+    robot->get_cVe(scratch.cVe);
+    scratch.eJe.resize(6, njoints);
+    scratch.q.resize(njoints);
+    scratch.qdot.resize(njoints);
+    return robot;
+  }
 
-  vpColVector vc(6); // Vel in m/s and rad/s
+  static void velocity(const VelocityMsg &msg, double v[])
+  {
+    // Vel in m/s and rad/s
+    v[0] = msg.twist.linear.x;
+    v[1] = msg.twist.linear.y;
+    v[2] = msg.twist.linear.z;
+    v[3] = msg.twist.angular.x;
+    v[4] = msg.twist.angular.y;
+    v[5] = msg.twist.angular.z;
+  }
 
-  vc[0] = msg->twist.linear.x;
-  vc[1] = msg->twist.linear.y;
-  vc[2] = msg->twist.linear.z;
+  static void position(const PositionMsg &, double [])
+  {
+  }
 
-  vc[3] = msg->twist.angular.x;
-  vc[4] = msg->twist.angular.y;
-  vc[5] = msg->twist.angular.z;
+  static void read(vpRobotAfma6 &robot, Scratch &scratch, vpROSRobotNodeState<njoints> &state)
+  {
+    double t;
+    robot.getPosition(vpRobot::ARTICULAR_FRAME, scratch.q, state.stamp);
+    robot.getVelocity(vpRobot::ARTICULAR_FRAME, scratch.qdot, t);
+    for(unsigned int i = 0; i < njoints; i++){
+      state.q[i] = scratch.q[i];
+      state.qdot[i] = scratch.qdot[i];
+    }
+
+    // The model is evaluated at the read q, into the preallocated buffers
+    robot.vpAfma6::get_fMc(scratch.q, scratch.fMc);
+    pose(scratch.fMc, state.pose);
+
+    // vpRobotAfma6::get_eJe() reads the robot, use the model at the read q
+    robot.vpAfma6::get_eJe(scratch.q, scratch.eJe);
+    double ve[6];
+    for(unsigned int i = 0; i < 6; i++){
+      ve[i] = 0.;
+      for(unsigned int j = 0; j < njoints; j++)
+        ve[i] += scratch.eJe[i][j] * scratch.qdot[j];
+    }
+    for(unsigned int i = 0; i < 6; i++){
+      state.twist[i] = 0.;
+      for(unsigned int j = 0; j < 6; j++)
+        state.twist[i] += scratch.cVe[i][j] * ve[j];
+    }
+  }
 
-//  ROS_INFO( "Afma6 new camera vel at %f s: [%0.2f %0.2f %0.2f] m/s [%0.2f %0.2f %0.2f] rad/s",
-//            veltime.toSec(),
-//            vc[0], vc[1], vc[2], vc[3], vc[4], vc[5]);
-  robot->setVelocity(vpRobot::CAMERA_FRAME, vc);
+  // Position and unit quaternion (x, y, z, qx, qy, qz, qw) of a pose,
+  // without the temporaries of vpQuaternionVector
+  static void pose(const vpHomogeneousMatrix &M, double p[7])
+  {
+    p[0] = M[0][3];
+    p[1] = M[1][3];
+    p[2] = M[2][3];
+    double tr = M[0][0] + M[1][1] + M[2][2];
+    if(tr > 0.){
+      double s = 2. * sqrt(tr + 1.);
+      p[3] = (M[2][1] - M[1][2]) / s;
+      p[4] = (M[0][2] - M[2][0]) / s;
+      p[5] = (M[1][0] - M[0][1]) / s;
+      p[6] = 0.25 * s;
+    }
+    else if(M[0][0] > M[1][1] && M[0][0] > M[2][2]){
+      double s = 2. * sqrt(1. + M[0][0] - M[1][1] - M[2][2]);
+      p[3] = 0.25 * s;
+      p[4] = (M[0][1] + M[1][0]) / s;
+      p[5] = (M[0][2] + M[2][0]) / s;
+      p[6] = (M[2][1] - M[1][2]) / s;
+    }
+    else if(M[1][1] > M[2][2]){
+      double s = 2. * sqrt(1. + M[1][1] - M[0][0] - M[2][2]);
+      p[3] = (M[0][1] + M[1][0]) / s;
+      p[4] = 0.25 * s;
+      p[5] = (M[1][2] + M[2][1]) / s;
+      p[6] = (M[0][2] - M[2][0]) / s;
+    }
+    else{
+      double s = 2. * sqrt(1. + M[2][2] - M[0][0] - M[1][1]);
+      p[3] = (M[0][2] + M[2][0]) / s;
+      p[4] = (M[1][2] + M[2][1]) / s;
+      p[5] = 0.25 * s;
+      p[6] = (M[1][0] - M[0][1]) / s;
+    }
+  }
+};
 
-//  this->publish();
-}
+typedef vpROSRobotNode<vpRobotAfma6, vpROSAfma6Traits> RosAfma6Node;
 
 #endif // #ifdef VISP_HAVE_AFMA6
 
@@ -183,6 +167,7 @@ int main( int argc, char** argv )
   light.on();
 
   RosAfma6Node *node = new RosAfma6Node(n);
+  node->setHardwarePriority(50);
 
   if( node->setup() != 0 )
   {
@@ -202,4 +187,3 @@ int main( int argc, char** argv )
 #endif
   return 0;
 }
-
@@ -0,0 +1,47 @@
+#include <visp_ros/vpROSSimulatedBase.h>
+
+#include <ros/ros.h>
+
+#include <string>
+
+/*
+  Simulated mobile base: subscribes to cmd_vel and publishes odom as a real
+  base driver would, to run vpROSRobot based control loops without hardware.
+
+  % rosrun visp_ros visp_ros_simulated_base_node _rate:=50 _latency:=0.04 _model:=unicycle
+
+  With _stamped:=true, the commands are geometry_msgs::TwistStamped, as
+  published by a vpROSRobot with setCommandStamped(true).
+*/
+int main( int argc, char** argv )
+{
+  ros::init(argc,argv, "visp_ros_simulated_base");
+  ros::NodeHandle n(std::string("~"));
+
+  double rate, latency, noise_linear, noise_angular;
+  bool stamped;
+  std::string model, nodespace;
+  n.param("rate", rate, 50.0);
+  n.param("latency", latency, 0.0);
+  n.param("noise_linear", noise_linear, 0.0);
+  n.param("noise_angular", noise_angular, 0.0);
+  n.param("model", model, std::string("unicycle"));
+  n.param("nodespace", nodespace, std::string(""));
+  n.param("stamped", stamped, false);
+
+  vpROSSimulatedBase base;
+  base.setModel(model == "holonomic" ? vpROSSimulatedBase::HOLONOMIC : vpROSSimulatedBase::UNICYCLE);
+  base.setRate(rate);
+  base.setLatency(latency);
+  base.setNoise(noise_linear, noise_angular);
+  base.setNodespace(nodespace);
+  base.setCommandStamped(stamped);
+
+  ROS_INFO( "Simulated %s base: odometry at %0.1f Hz, command latency %0.3f s",
+            model.c_str(), rate, latency );
+  base.start();
+  ros::waitForShutdown();
+  base.stop();
+
+  return 0;
+}
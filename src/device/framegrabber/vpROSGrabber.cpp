@@ -52,17 +52,37 @@
 #include <visp/vpFrameGrabberException.h>
 #include <sensor_msgs/CompressedImage.h>
 #include <cv_bridge/cv_bridge.h>
+#include <sensor_msgs/image_encodings.h>
+#if VISP_HAVE_OPENCV_VERSION >= 0x020101
+#  include <opencv2/imgproc/imgproc.hpp>
+#else
+#  include <cv.h>
+#endif
 
 #include <iostream>
 #include <math.h>
 
+namespace {
+
+/*
+  True if the buffer is referenced by someone else than its owner.
+*/
+bool isShared(const cv::Mat &m)
+{
+#if VISP_HAVE_OPENCV_VERSION >= 0x030000
+  return m.u != NULL && m.u->refcount > 1;
+#else
+  return m.refcount != NULL && *m.refcount > 1;
+#endif
+}
+
+}
+
 /*!
 	Basic Constructor.
 */
 vpROSGrabber::vpROSGrabber() :
     isInitialized(false),
-    mutex_image(true),
-    mutex_param(true),
     first_img_received(false),
     first_param_received(false),
     _rectify(true),
@@ -73,7 +93,15 @@ vpROSGrabber::vpROSGrabber() :
     _nodespace(""),
     _image_transport("raw"),
     _sec(0),
-    _nsec(0)
+    _nsec(0),
+    _max_rate(0.),
+    _decimation(1),
+    _decimation_count(0),
+    stop_workers(false),
+    frame_queue_size(1),
+    frame_pool(4),
+    frame_pool_next(0),
+    pool_misses(0)
 {
 
 }
@@ -213,13 +241,13 @@ void vpROSGrabber::acquire(vpImage<unsigned char> &I, struct timespec &timestamp
         throw (vpFrameGrabberException(vpFrameGrabberException::initializationError,
                      "Initialization not done") );
     }
-    while(!mutex_image || !first_img_received);
-    mutex_image = false;
+    boost::mutex::scoped_lock lock(mutex_image);
+    while(!first_img_received)
+        cond_image.wait(lock);
     timestamp . tv_sec = _sec;
     timestamp . tv_nsec = _nsec;
     vpImageConvert::convert(data, I, flip);
     first_img_received = false;
-    mutex_image = true;
 }
 
 
@@ -247,14 +275,12 @@ bool vpROSGrabber::acquireNoWait(vpImage<unsigned char> &I, struct timespec &tim
         throw (vpFrameGrabberException(vpFrameGrabberException::initializationError,
                      "Initialization not done") );
     }
-    while(!mutex_image);
-    mutex_image = false;
+    boost::mutex::scoped_lock lock(mutex_image);
     timestamp . tv_sec = _sec;
     timestamp . tv_nsec = _nsec;
     vpImageConvert::convert(data, I, flip);
     new_image = first_img_received;
     first_img_received = false;
-    mutex_image = true;
     return new_image;
 }
 
@@ -278,13 +304,13 @@ void vpROSGrabber::acquire(vpImage<vpRGBa> &I, struct timespec &timestamp)
         throw (vpFrameGrabberException(vpFrameGrabberException::initializationError,
                      "Initialization not done") );
     }
-    while(!mutex_image || !first_img_received);
-    mutex_image = false;
+    boost::mutex::scoped_lock lock(mutex_image);
+    while(!first_img_received)
+        cond_image.wait(lock);
     timestamp . tv_sec = _sec;
     timestamp . tv_nsec = _nsec;
     vpImageConvert::convert(data, I, flip);
     first_img_received = false;
-    mutex_image = true;
 }
 
 
@@ -312,14 +338,12 @@ bool vpROSGrabber::acquireNoWait(vpImage<vpRGBa> &I, struct timespec &timestamp)
         throw (vpFrameGrabberException(vpFrameGrabberException::initializationError,
                      "Initialization not done") );
     }
-    while(!mutex_image);
-    mutex_image = false;
+    boost::mutex::scoped_lock lock(mutex_image);
     timestamp . tv_sec = _sec;
     timestamp . tv_nsec = _nsec;
     vpImageConvert::convert(data, I, flip);
     new_image = first_img_received;
     first_img_received = false;
-    mutex_image = true;
     return new_image;
 }
 
@@ -328,10 +352,16 @@ bool vpROSGrabber::acquireNoWait(vpImage<vpRGBa> &I, struct timespec &timestamp)
 /*!
   Grab an image direclty in the OpenCV format.
 
+  The returned image is taken from the grabber buffer pool and is not reused
+  by the grabber as long as it is referenced, so no allocation happens in
+  steady state as long as the previous images are released.
+
   \param timestamp : timestamp of the acquired image.
 
   \return Acquired image.
 
+  \sa setBufferPoolSize()
+
   \exception vpFrameGrabberException::initializationError If the
   initialization of the grabber was not done previously.
 */
@@ -344,13 +374,13 @@ cv::Mat vpROSGrabber::acquire(struct timespec &timestamp)
         throw (vpFrameGrabberException(vpFrameGrabberException::initializationError,
                      "Initialization not done") );
     }
-    while(!mutex_image || !first_img_received);
-    mutex_image = false;
+    boost::mutex::scoped_lock lock(mutex_image);
+    while(!first_img_received)
+        cond_image.wait(lock);
     timestamp . tv_sec = _sec;
     timestamp . tv_nsec = _nsec;
-    retour = data.clone();
+    retour = copyToPool();
     first_img_received = false;
-    mutex_image = true;
     return retour;
 }
 
@@ -443,7 +473,69 @@ cv::Mat vpROSGrabber::acquire()
 }
 
 
+/*!
+  Request the next image without blocking.
+
+  The returned future becomes ready as soon as the next image is received
+  and converted. Images are shared between all the futures waiting for the
+  same image and must be considered as read-only. The futures do not consume
+  the image, it is still returned by a concurrent acquire().
+
+  \return Future on the next acquired frame.
+
+  \exception vpFrameGrabberException::initializationError If the
+  initialization of the grabber was not done previously.
+
+  \sa setFrameCallback()
+*/
+boost::unique_future<vpROSGrabber::Frame> vpROSGrabber::acquireAsync()
+{
+    if (isInitialized==false)
+    {
+        close();
+        throw (vpFrameGrabberException(vpFrameGrabberException::initializationError,
+                     "Initialization not done") );
+    }
+    boost::shared_ptr< boost::promise<Frame> > promise(new boost::promise<Frame>);
+    boost::mutex::scoped_lock lock(mutex_image);
+    pending_frames.push_back(promise);
+    return promise->get_future();
+}
+
+
+/*!
+  Set a function called on each new image.
+
+  The callback is run by a pool of worker threads owned by the grabber, so
+  that the processing of a frame overlaps with the acquisition of the next
+  one. At most one frame per worker is queued; when the workers are late the
+  oldest queued frame is dropped. The same frame is never given to two workers.
+
+  \param callback : Function called with each new frame. An empty function
+  removes the current callback and stops the workers.
+
+  \param nthreads : Number of worker threads (1 by default). With more than one
+  thread, callbacks may run concurrently and complete out of order.
+
+  \sa acquireAsync()
+*/
+void vpROSGrabber::setFrameCallback(boost::function<void(const Frame&)> callback, unsigned int nthreads)
+{
+    stopWorkers();
+    {
+        boost::mutex::scoped_lock lock(mutex_worker);
+        frame_callback = callback;
+        frame_queue_size = (nthreads > 0) ? nthreads : 1;
+    }
+    if(callback.empty())
+        return;
+    for(unsigned int i = 0; i < frame_queue_size; i++)
+        worker_threads.push_back(new boost::thread(&vpROSGrabber::frameWorker, this));
+}
+
+
 void vpROSGrabber::close(){
+	stopWorkers();
 	if(isInitialized){
 		isInitialized = false;
 		spinner->stop();
@@ -481,6 +573,75 @@ void vpROSGrabber::setRectify(bool rectify)
 }
 
 
+/*!
+    Limit the rate of the processed images.
+
+    Images arriving faster than the given rate are dropped at the very beginning
+    of the image callback, before any decoding, copy or rectification.
+    The rate is computed from the image timestamps.
+
+    \param hz : Maximum rate in Hz. 0 (default) means no limitation.
+
+    \sa setDecimation()
+*/
+void vpROSGrabber::setMaxRate(double hz)
+{
+    boost::mutex::scoped_lock lock(mutex_throttle);
+    _max_rate = (hz > 0.) ? hz : 0.;
+    _next_stamp = ros::Time();
+}
+
+
+/*!
+    Keep only one image every n received images.
+
+    Surplus images are dropped at the very beginning of the image callback,
+    before any decoding, copy or rectification.
+
+    \param n : Decimation factor. 1 (default) keeps every image.
+
+    \sa setMaxRate()
+*/
+void vpROSGrabber::setDecimation(unsigned int n)
+{
+    boost::mutex::scoped_lock lock(mutex_throttle);
+    _decimation = (n > 0) ? n : 1;
+    _decimation_count = 0;
+}
+
+
+/*!
+    Set the number of buffers used to return images by acquire(struct timespec &),
+    acquireAsync() and the frame callback. A buffer is reused only when it is
+    no more referenced by the user. Has to be called before open().
+
+    \param n : Number of buffers (4 by default).
+
+    \sa getBufferPoolMisses()
+*/
+void vpROSGrabber::setBufferPoolSize(unsigned int n)
+{
+    boost::mutex::scoped_lock lock(mutex_image);
+    frame_pool.resize((n > 0) ? n : 1);
+    frame_pool_next = 0;
+}
+
+
+/*!
+    Get the number of times an image had to be allocated because all the
+    buffers of the pool were still referenced by the user.
+
+    \return Number of allocations done outside of the pool.
+
+    \sa setBufferPoolSize()
+*/
+unsigned long vpROSGrabber::getBufferPoolMisses()
+{
+    boost::mutex::scoped_lock lock(mutex_image);
+    return pool_misses;
+}
+
+
 /*!
 	Get the width of the image.
 
@@ -602,68 +763,250 @@ void vpROSGrabber::setImageTransport(std::string image_transport)
 */
 
 void vpROSGrabber::getCameraInfo(vpCameraParameters &cam){
-	while(!mutex_param || !first_param_received);
-	mutex_param = false;
+	boost::mutex::scoped_lock lock(mutex_param);
+	while(!first_param_received)
+		cond_param.wait(lock);
 	cam = _cam;
-	mutex_param = true;
+}
+
+
+/*!
+    Decide if an incoming image has to be dropped according to the decimation
+    factor and the maximum rate. Only called from the spinner thread.
+
+    \param stamp : timestamp of the incoming image. When the driver does not
+    stamp its images (zero stamp), the reception time is used instead.
+
+    \return true if the image has to be dropped.
+*/
+bool vpROSGrabber::dropFrame(const ros::Time &header_stamp){
+    boost::mutex::scoped_lock lock(mutex_throttle);
+    if(_decimation > 1){
+        if(_decimation_count++ % _decimation != 0)
+            return true;
+    }
+    if(_max_rate > 0.){
+        ros::Time stamp = header_stamp.isZero() ? ros::Time::now() : header_stamp;
+        ros::Duration period(1. / _max_rate);
+        if(!_next_stamp.isZero() && stamp < _next_stamp && _next_stamp - stamp <= period)
+            return true;
+        // Advance by whole periods to keep the mean rate, restart if late or if time jumped back
+        if(_next_stamp.isZero() || stamp < _next_stamp || stamp - _next_stamp > period)
+            _next_stamp = stamp + period;
+        else
+            _next_stamp += period;
+    }
+    return false;
 }
 
 
 void vpROSGrabber::imageCallback(const sensor_msgs::CompressedImage::ConstPtr& msg){
+    if(dropFrame(msg->header.stamp))
+        return;
 
-	cv::Mat data_t = cv::imdecode(msg->data,1);
-	cv::Size data_size = data_t.size();
+    // Decode and rectify outside the lock in buffers reused from frame to frame
+    bool rectify = _rectify && p.initialized();
+    cv::Mat &decoded = rectify ? decode_buffer : back_buffer;
+    cv::imdecode(cv::Mat(msg->data), 1, &decoded);
+    cv::Size data_size = decoded.size();
+    if(rectify)
+        p.rectifyImage(decode_buffer, back_buffer);
 
-    while(!mutex_image);
-    mutex_image = false;
-    if(_rectify && p.initialized()){
-		p.rectifyImage(data_t,data);	
-	}else{
-		data_t.copyTo(data);
-	}
-	usWidth = data_size.width;
-	usHeight = data_size.height;
-    _sec = msg->header.stamp.sec;
-    _nsec = msg->header.stamp.nsec;
-	first_img_received = true;
-	mutex_image = true;
+    {
+        boost::mutex::scoped_lock lock(mutex_image);
+        cv::swap(data, back_buffer);
+        usWidth = data_size.width;
+        usHeight = data_size.height;
+        _sec = msg->header.stamp.sec;
+        _nsec = msg->header.stamp.nsec;
+        first_img_received = true;
+    }
+    cond_image.notify_all();
+    dispatchFrame();
 }
 
 
 void vpROSGrabber::imageCallbackRaw(const sensor_msgs::Image::ConstPtr& msg){
-	while(!mutex_image);
-	mutex_image = false;
-	cv_bridge::CvImageConstPtr cv_ptr;
-	try
-	{
-	  cv_ptr = cv_bridge::toCvShare(msg, "bgr8");
-	}
-	catch (cv_bridge::Exception& e)
-	{
-	  ROS_ERROR("cv_bridge exception: %s", e.what());
-	  return;
-	}
+	if(dropFrame(msg->header.stamp))
+		return;
+    // Wrap the message data for the usual encodings, cv_bridge allocates a new image object per message
+    cv_bridge::CvImageConstPtr cv_ptr;
+    cv::Mat raw;
+    if(msg->encoding == sensor_msgs::image_encodings::BGR8)
+        raw = cv::Mat(msg->height, msg->width, CV_8UC3, const_cast<uint8_t *>(&msg->data[0]), msg->step);
+    else if(msg->encoding == sensor_msgs::image_encodings::RGB8 || msg->encoding == sensor_msgs::image_encodings::MONO8){
+        bool rgb = (msg->encoding == sensor_msgs::image_encodings::RGB8);
+        cv::Mat src(msg->height, msg->width, rgb ? CV_8UC3 : CV_8UC1, const_cast<uint8_t *>(&msg->data[0]), msg->step);
+        cv::cvtColor(src, decode_buffer, rgb ? CV_RGB2BGR : CV_GRAY2BGR);
+        raw = decode_buffer;
+    }
+    else{
+        try
+        {
+            cv_ptr = cv_bridge::toCvShare(msg, "bgr8");
+        }
+        catch (cv_bridge::Exception& e)
+        {
+            ROS_ERROR("cv_bridge exception: %s", e.what());
+            return;
+        }
+        raw = cv_ptr->image;
+    }
     if(_rectify && p.initialized()){
-        p.rectifyImage(cv_ptr->image,data);
+        p.rectifyImage(raw,back_buffer);
     }else{
-        cv_ptr->image.copyTo(data);
+        raw.copyTo(back_buffer);
+    }
+    {
+        boost::mutex::scoped_lock lock(mutex_image);
+        cv::swap(data, back_buffer);
+        cv::Size data_size = data.size();
+        usWidth = data_size.width;
+        usHeight = data_size.height;
+        _sec = msg->header.stamp.sec;
+        _nsec = msg->header.stamp.nsec;
+        first_img_received = true;
     }
-	cv::Size data_size = data.size();
-	usWidth = data_size.width;
-	usHeight = data_size.height;
-    _sec = msg->header.stamp.sec;
-    _nsec = msg->header.stamp.nsec;
-	first_img_received = true;
-	mutex_image = true;
+    cond_image.notify_all();
+    dispatchFrame();
 }
 
 void vpROSGrabber::paramCallback(const sensor_msgs::CameraInfo::ConstPtr& msg){
-	while(!mutex_param);
-	mutex_param = false;
-	_cam = visp_bridge::toVispCameraParameters(*msg);
-	p.fromCameraInfo(msg);
-	first_param_received = true;
-	mutex_param = true;
+	{
+		boost::mutex::scoped_lock lock(mutex_param);
+		_cam = visp_bridge::toVispCameraParameters(*msg);
+		p.fromCameraInfo(msg);
+		first_param_received = true;
+	}
+	cond_param.notify_all();
+	allocateBuffers(msg->width, msg->height);
+}
+
+
+/*!
+    Allocate the image buffers before the first image is received, so that
+    the streaming does not allocate once started. Buffers that are already
+    allocated are kept; later size changes are handled when images arrive.
+
+    \param width, height : Size of the images.
+*/
+void vpROSGrabber::allocateBuffers(unsigned int width, unsigned int height){
+    if(width == 0 || height == 0 || !back_buffer.empty())
+        return;
+    decode_buffer.create(height, width, CV_8UC3);
+    back_buffer.create(height, width, CV_8UC3);
+    boost::mutex::scoped_lock lock(mutex_image);
+    if(data.empty())
+        data.create(height, width, CV_8UC3);
+    for(size_t i = 0; i < frame_pool.size(); i++)
+        if(frame_pool[i].empty())
+            frame_pool[i].create(height, width, CV_8UC3);
+}
+
+
+/*!
+    Copy the last image in a buffer of the pool that is no more referenced
+    outside of the grabber. Falls back to an allocation when all the buffers
+    are still in use. Has to be called with mutex_image locked.
+
+    \return Copy of the last image.
+*/
+cv::Mat vpROSGrabber::copyToPool(){
+    size_t size = frame_pool.size();
+    for(size_t i = 0; i < size; i++){
+        size_t index = (frame_pool_next + i) % size;
+        if(!isShared(frame_pool[index])){
+            data.copyTo(frame_pool[index]);
+            frame_pool_next = (index + 1) % size;
+            return frame_pool[index];
+        }
+    }
+    pool_misses++;
+    return data.clone();
+}
+
+
+/*!
+    Hand the last received image over to the pending acquireAsync() futures
+    and to the frame callback workers. Called from the spinner thread once
+    the image is converted.
+*/
+void vpROSGrabber::dispatchFrame(){
+    bool callback;
+    {
+        boost::mutex::scoped_lock lock(mutex_worker);
+        callback = !frame_callback.empty();
+    }
+
+    std::vector< boost::shared_ptr< boost::promise<Frame> > > promises;
+    Frame frame;
+    {
+        boost::mutex::scoped_lock lock(mutex_image);
+        if(pending_frames.empty() && !callback)
+            return;
+        promises.swap(pending_frames);
+        frame.image = copyToPool();
+        frame.timestamp.tv_sec = _sec;
+        frame.timestamp.tv_nsec = _nsec;
+    }
+
+    for(size_t i = 0; i < promises.size(); i++)
+        promises[i]->set_value(frame);
+
+    if(callback){
+        boost::mutex::scoped_lock lock(mutex_worker);
+        if(frame_queue.size() >= frame_queue_size)
+            frame_queue.pop_front();
+        frame_queue.push_back(frame);
+        cond_worker.notify_one();
+    }
+}
+
+
+/*!
+    Worker thread running the frame callback on the queued frames.
+*/
+void vpROSGrabber::frameWorker(){
+    for(;;){
+        Frame frame;
+        boost::function<void(const Frame&)> callback;
+        {
+            boost::mutex::scoped_lock lock(mutex_worker);
+            while(frame_queue.empty() && !stop_workers)
+                cond_worker.wait(lock);
+            if(stop_workers)
+                return;
+            frame = frame_queue.front();
+            frame_queue.pop_front();
+            callback = frame_callback;
+        }
+        try{
+            callback(frame);
+        }
+        catch(std::exception &e){
+            ROS_ERROR("vpROSGrabber frame callback exception: %s", e.what());
+        }
+    }
+}
+
+
+/*!
+    Stop and join the frame callback workers.
+*/
+void vpROSGrabber::stopWorkers(){
+    {
+        boost::mutex::scoped_lock lock(mutex_worker);
+        stop_workers = true;
+        frame_queue.clear();
+    }
+    cond_worker.notify_all();
+    for(size_t i = 0; i < worker_threads.size(); i++){
+        worker_threads[i]->join();
+        delete worker_threads[i];
+    }
+    worker_threads.clear();
+    boost::mutex::scoped_lock lock(mutex_worker);
+    stop_workers = false;
 }
 
 #endif
@@ -0,0 +1,751 @@
+/****************************************************************************
+ *
+ * $Id: vpROSStereoGrabber.cpp $
+ *
+ * This file is part of the ViSP software.
+ * Copyright (C) 2005 - 2014 by INRIA. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact INRIA about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://www.irisa.fr/lagadic/visp/visp.html for more information.
+ *
+ * This software was developed at:
+ * INRIA Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ * http://www.irisa.fr/lagadic
+ *
+ * If you have questions regarding the use of this file, please contact
+ * INRIA at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *
+ * Description:
+ * Stereo camera video capture for ROS middleware.
+ *
+ * Authors:
+ * agent
+ *
+ *****************************************************************************/
+
+/*!
+  \file vpROSStereoGrabber.cpp
+  \brief class for stereo cameras video capture using ROS middleware.
+*/
+
+#include <visp_ros/vpROSStereoGrabber.h>
+
+#if defined(VISP_HAVE_OPENCV)
+
+#include <visp/vpImageConvert.h>
+#include <visp/vpFrameGrabberException.h>
+#include <visp_bridge/camera.h>
+#include <cv_bridge/cv_bridge.h>
+#include <boost/bind.hpp>
+
+#include <iostream>
+#include <algorithm>
+
+namespace {
+
+bool sameCalibration(const sensor_msgs::CameraInfo &a, const sensor_msgs::CameraInfo &b)
+{
+  return a.width == b.width && a.height == b.height
+      && a.binning_x == b.binning_x && a.binning_y == b.binning_y
+      && a.roi.x_offset == b.roi.x_offset && a.roi.y_offset == b.roi.y_offset
+      && a.roi.width == b.roi.width && a.roi.height == b.roi.height
+      && a.D == b.D
+      && std::equal(a.K.begin(), a.K.end(), b.K.begin())
+      && std::equal(a.R.begin(), a.R.end(), b.R.begin())
+      && std::equal(a.P.begin(), a.P.end(), b.P.begin());
+}
+
+/*
+  Rectification maps of a camera for the binning and the region of interest
+  given in its CameraInfo. P is set to the projection matrix of the
+  rectified images, in the same binned and cropped pixels.
+*/
+void initRectifyMap(const sensor_msgs::CameraInfo &info, cv::Mat &map1, cv::Mat &map2, cv::Matx34d &P)
+{
+  const uint32_t bx = std::max<uint32_t>(info.binning_x, 1);
+  const uint32_t by = std::max<uint32_t>(info.binning_y, 1);
+  cv::Matx33d K(&info.K[0]);
+  cv::Matx33d R(&info.R[0]);
+  P = cv::Matx34d(&info.P[0]);
+  K(0,0) /= bx; K(0,2) /= bx;
+  K(1,1) /= by; K(1,2) /= by;
+  P(0,0) /= bx; P(0,2) /= bx; P(0,3) /= bx;
+  P(1,1) /= by; P(1,2) /= by; P(1,3) /= by;
+
+  cv::Size size(info.width / bx, info.height / by);
+  cv::initUndistortRectifyMap(cv::Mat(K), cv::Mat(info.D), cv::Mat(R), cv::Mat(P), size, CV_16SC2, map1, map2);
+
+  // The ROI is given in full resolution pixels, the rectified image is cropped like the raw one
+  if(info.roi.width > 0 && info.roi.height > 0){
+    cv::Rect roi(info.roi.x_offset / bx, info.roi.y_offset / by, info.roi.width / bx, info.roi.height / by);
+    roi &= cv::Rect(0, 0, size.width, size.height);
+    cv::Mat cropped;
+    cv::subtract(map1(roi), cv::Scalar(roi.x, roi.y), cropped);
+    map1 = cropped;
+    map2 = map2(roi);
+    P(0,2) -= roi.x;
+    P(1,2) -= roi.y;
+  }
+}
+
+void convertImage(const cv::Mat &src, vpImage<unsigned char> &dst, bool flip)
+{
+  vpImageConvert::convert(src, dst, flip);
+}
+
+void convertImage(const cv::Mat &src, vpImage<vpRGBa> &dst, bool flip)
+{
+  vpImageConvert::convert(src, dst, flip);
+}
+
+void convertImage(const cv::Mat &src, cv::Mat &dst, bool flip)
+{
+  if(flip)
+    cv::flip(src, dst, 0);
+  else
+    src.copyTo(dst);
+}
+
+#if VISP_HAVE_OPENCV_VERSION >= 0x020403
+/*
+  Remaps the left (0) and right (1) images in parallel.
+*/
+class StereoRectifyBody : public cv::ParallelLoopBody
+{
+  public:
+    StereoRectifyBody(const cv::Mat *src, cv::Mat *dst, const cv::Mat *map1, const cv::Mat *map2)
+      : src_(src), dst_(dst), map1_(map1), map2_(map2) {}
+
+    void operator()(const cv::Range &range) const
+    {
+      for(int i = range.start; i < range.end; i++)
+        cv::remap(src_[i], dst_[i], map1_[i], map2_[i], cv::INTER_LINEAR);
+    }
+
+  private:
+    const cv::Mat *src_;
+    cv::Mat *dst_;
+    const cv::Mat *map1_;
+    const cv::Mat *map2_;
+};
+#endif
+
+}
+
+/*!
+  Basic Constructor.
+*/
+vpROSStereoGrabber::vpROSStereoGrabber() :
+    n(NULL),
+    left_data(NULL),
+    right_data(NULL),
+    sync(NULL),
+    spinner(NULL),
+    isInitialized(false),
+    usWidth(640),
+    usHeight(480),
+    left_info_received(false),
+    right_info_received(false),
+    maps_valid(false),
+    flip(false),
+    _rectify(true),
+    first_img_received(false),
+    first_param_received(false),
+    _sec(0),
+    _nsec(0),
+    _master_uri("http://127.0.0.1:11311"),
+    _topic_left_image("left/image_raw"),
+    _topic_left_info("left/camera_info"),
+    _topic_right_image("right/image_raw"),
+    _topic_right_info("right/camera_info"),
+    _nodespace(""),
+    _sync_queue_size(5)
+{
+
+}
+
+
+/*!
+  Basic destructor that calls the close() method.
+
+  \sa close()
+*/
+vpROSStereoGrabber::~vpROSStereoGrabber()
+{
+  close();
+}
+
+
+/*!
+  Initialization of the grabber.
+  Generic initialization of the grabber using parameter from the main function
+  To be used to create ros node that can be started with rosrun
+
+  \param argc : number of arguments from the main function
+
+  \param argv : arguments from the main function
+
+*/
+void vpROSStereoGrabber::open(int argc, char **argv)
+{
+  if(!isInitialized){
+    if(!ros::isInitialized()) ros::init(argc, argv, "visp_node", ros::init_options::AnonymousName);
+    n = new ros::NodeHandle;
+
+    left_data = new message_filters::Subscriber<sensor_msgs::Image>(*n, _nodespace + _topic_left_image, 1, ros::TransportHints().tcpNoDelay());
+    right_data = new message_filters::Subscriber<sensor_msgs::Image>(*n, _nodespace + _topic_right_image, 1, ros::TransportHints().tcpNoDelay());
+    sync = new message_filters::Synchronizer<SyncPolicy>(SyncPolicy(_sync_queue_size), *left_data, *right_data);
+    sync->registerCallback(boost::bind(&vpROSStereoGrabber::imageCallback, this, _1, _2));
+
+    left_info = n->subscribe(_nodespace + _topic_left_info, 1, &vpROSStereoGrabber::leftParamCallback, this, ros::TransportHints().tcpNoDelay());
+    right_info = n->subscribe(_nodespace + _topic_right_info, 1, &vpROSStereoGrabber::rightParamCallback, this, ros::TransportHints().tcpNoDelay());
+
+    spinner = new ros::AsyncSpinner(1);
+    spinner->start();
+    isInitialized = true;
+  }
+}
+
+
+/*!
+  Initialization of the grabber.
+
+  Generic initialization of the grabber.
+
+  \exception vpFrameGrabberException::initializationError If ROS has already been initialised with a different master_URI.
+
+*/
+void vpROSStereoGrabber::open()
+{
+  if(ros::isInitialized() && ros::master::getURI() != _master_uri){
+    close();
+    throw (vpFrameGrabberException(vpFrameGrabberException::initializationError,
+                                   "ROS already initialised with a different master_URI (" + ros::master::getURI() +" != " + _master_uri + ")") );
+  }
+  if(!isInitialized){
+    int argc = 2;
+    std::string exe = "ros.exe", arg1 = "__master:=" + _master_uri;
+    char *argv[2] = { &exe[0], &arg1[0] };
+    open(argc, argv);
+  }
+}
+
+
+/*!
+  Stop the acquisition and release the ROS subscribers.
+*/
+void vpROSStereoGrabber::close()
+{
+  if(isInitialized){
+    isInitialized = false;
+    spinner->stop();
+    delete spinner;
+    delete sync;
+    delete left_data;
+    delete right_data;
+    delete n;
+  }
+}
+
+
+/*!
+  Convert the last synchronized pair into Il and Ir.
+
+  \param Il, Ir : Acquired left and right images.
+
+  \param timestamp : timestamp of the left image of the pair.
+
+  \param wait : If true, wait until a new pair is received.
+
+  \return true if a new pair was acquired.
+*/
+template<class Image>
+bool vpROSStereoGrabber::grab(Image &Il, Image &Ir, struct timespec &timestamp, bool wait)
+{
+  if (isInitialized==false)
+  {
+    close();
+    throw (vpFrameGrabberException(vpFrameGrabberException::initializationError,
+                                   "Initialization not done") );
+  }
+  boost::mutex::scoped_lock lock(mutex_image);
+  if(wait){
+    while(!first_img_received)
+      cond_image.wait(lock);
+  }
+  bool new_image = first_img_received;
+  timestamp.tv_sec = _sec;
+  timestamp.tv_nsec = _nsec;
+  if(!data[0].empty()){
+    convertImage(data[0], Il, flip);
+    convertImage(data[1], Ir, flip);
+  }
+  first_img_received = false;
+  return new_image;
+}
+
+
+/*!
+  Grab a rectified gray level stereo pair with timestamp.
+
+  \param Il, Ir : Acquired left and right gray level images.
+
+  \param timestamp : timestamp of the acquired pair.
+
+  \exception vpFrameGrabberException::initializationError If the
+  initialization of the grabber was not done previously.
+*/
+void vpROSStereoGrabber::acquire(vpImage<unsigned char> &Il, vpImage<unsigned char> &Ir, struct timespec &timestamp)
+{
+  grab(Il, Ir, timestamp, true);
+}
+
+
+/*!
+  Grab a rectified color stereo pair with timestamp.
+
+  \param Il, Ir : Acquired left and right color images.
+
+  \param timestamp : timestamp of the acquired pair.
+
+  \exception vpFrameGrabberException::initializationError If the
+  initialization of the grabber was not done previously.
+*/
+void vpROSStereoGrabber::acquire(vpImage<vpRGBa> &Il, vpImage<vpRGBa> &Ir, struct timespec &timestamp)
+{
+  grab(Il, Ir, timestamp, true);
+}
+
+
+/*!
+  Grab a rectified stereo pair directly in the OpenCV format.
+
+  \param Il, Ir : Acquired left and right images.
+
+  \param timestamp : timestamp of the acquired pair.
+
+  \exception vpFrameGrabberException::initializationError If the
+  initialization of the grabber was not done previously.
+*/
+void vpROSStereoGrabber::acquire(cv::Mat &Il, cv::Mat &Ir, struct timespec &timestamp)
+{
+  grab(Il, Ir, timestamp, true);
+}
+
+
+/*!
+  Grab a rectified gray level stereo pair with timestamp without waiting.
+
+  \param Il, Ir : Acquired left and right gray level images.
+
+  \param timestamp : timestamp of the acquired pair.
+
+  \return true if a new pair was acquired
+
+  \exception vpFrameGrabberException::initializationError If the
+  initialization of the grabber was not done previously.
+*/
+bool vpROSStereoGrabber::acquireNoWait(vpImage<unsigned char> &Il, vpImage<unsigned char> &Ir, struct timespec &timestamp)
+{
+  return grab(Il, Ir, timestamp, false);
+}
+
+
+/*!
+  Grab a rectified color stereo pair with timestamp without waiting.
+
+  \param Il, Ir : Acquired left and right color images.
+
+  \param timestamp : timestamp of the acquired pair.
+
+  \return true if a new pair was acquired
+
+  \exception vpFrameGrabberException::initializationError If the
+  initialization of the grabber was not done previously.
+*/
+bool vpROSStereoGrabber::acquireNoWait(vpImage<vpRGBa> &Il, vpImage<vpRGBa> &Ir, struct timespec &timestamp)
+{
+  return grab(Il, Ir, timestamp, false);
+}
+
+
+/*!
+  Grab a rectified gray level stereo pair.
+
+  \param Il, Ir : Acquired left and right gray level images.
+*/
+void vpROSStereoGrabber::acquire(vpImage<unsigned char> &Il, vpImage<unsigned char> &Ir)
+{
+  struct timespec timestamp;
+  acquire(Il, Ir, timestamp);
+}
+
+
+/*!
+  Grab a rectified color stereo pair.
+
+  \param Il, Ir : Acquired left and right color images.
+*/
+void vpROSStereoGrabber::acquire(vpImage<vpRGBa> &Il, vpImage<vpRGBa> &Ir)
+{
+  struct timespec timestamp;
+  acquire(Il, Ir, timestamp);
+}
+
+
+/*!
+  Grab a rectified stereo pair directly in the OpenCV format.
+
+  \param Il, Ir : Acquired left and right images.
+*/
+void vpROSStereoGrabber::acquire(cv::Mat &Il, cv::Mat &Ir)
+{
+  struct timespec timestamp;
+  acquire(Il, Ir, timestamp);
+}
+
+
+/*!
+  Grab a rectified gray level stereo pair without waiting.
+
+  \param Il, Ir : Acquired left and right gray level images.
+
+  \return true if a new pair was acquired
+*/
+bool vpROSStereoGrabber::acquireNoWait(vpImage<unsigned char> &Il, vpImage<unsigned char> &Ir)
+{
+  struct timespec timestamp;
+  return acquireNoWait(Il, Ir, timestamp);
+}
+
+
+/*!
+  Grab a rectified color stereo pair without waiting.
+
+  \param Il, Ir : Acquired left and right color images.
+
+  \return true if a new pair was acquired
+*/
+bool vpROSStereoGrabber::acquireNoWait(vpImage<vpRGBa> &Il, vpImage<vpRGBa> &Ir)
+{
+  struct timespec timestamp;
+  return acquireNoWait(Il, Ir, timestamp);
+}
+
+
+/*!
+  Set the ROS topic name of the left images.
+
+  \param topic_name name of the topic.
+*/
+void vpROSStereoGrabber::setLeftImageTopic(std::string topic_name)
+{
+  _topic_left_image = topic_name;
+}
+
+
+/*!
+  Set the ROS topic name of the left CameraInfo.
+
+  \param topic_name name of the topic.
+*/
+void vpROSStereoGrabber::setLeftCameraInfoTopic(std::string topic_name)
+{
+  _topic_left_info = topic_name;
+}
+
+
+/*!
+  Set the ROS topic name of the right images.
+
+  \param topic_name name of the topic.
+*/
+void vpROSStereoGrabber::setRightImageTopic(std::string topic_name)
+{
+  _topic_right_image = topic_name;
+}
+
+
+/*!
+  Set the ROS topic name of the right CameraInfo.
+
+  \param topic_name name of the topic.
+*/
+void vpROSStereoGrabber::setRightCameraInfoTopic(std::string topic_name)
+{
+  _topic_right_info = topic_name;
+}
+
+
+/*!
+  Set the URI for ROS Master
+
+  \param master_uri URI of the master ("http://127.0.0.1:11311")
+*/
+void vpROSStereoGrabber::setMasterURI(std::string master_uri)
+{
+  _master_uri = master_uri;
+}
+
+
+/*!
+  Set the nodespace
+
+  \param nodespace Namespace of the connected stereo camera (nodespace is appended to the all topic names)
+*/
+void vpROSStereoGrabber::setNodespace(std::string nodespace)
+{
+  _nodespace = nodespace;
+}
+
+
+/*!
+  Set the number of messages kept by the approximate time synchronizer
+  to match left and right images. Has to be called before open().
+
+  \param queue_size Size of the synchronizer queue (5 by default).
+*/
+void vpROSStereoGrabber::setSyncQueueSize(unsigned int queue_size)
+{
+  _sync_queue_size = queue_size;
+}
+
+
+/*!
+  Set the boolean variable flip to the expected value.
+
+  \param flipType : Expected value of the variable flip. True means that both images are flipped during each acquisition.
+*/
+void vpROSStereoGrabber::setFlip(bool flipType)
+{
+  flip = flipType;
+}
+
+
+/*!
+  Set the boolean variable rectify to the expected value.
+
+  \param rectify : Expected value of the variable rectify. True means that the stereo pair is rectified during each acquisition.
+
+  \warning While rectification is enabled, the stereo pairs are dropped until
+  both CameraInfo are received, and when the image size does not match its
+  CameraInfo, so that acquire() never returns unrectified images.
+*/
+void vpROSStereoGrabber::setRectify(bool rectify)
+{
+  _rectify = rectify;
+}
+
+
+/*!
+  Get the camera parameters of the left and right cameras.
+
+  When rectification is enabled, the parameters are the ones of the rectified
+  images (taken from the projection matrices P, scaled by the binning and
+  shifted by the region of interest) and have no distortion.
+
+  \param cam_left, cam_right parameters of the left and right cameras
+*/
+void vpROSStereoGrabber::getCameraInfo(vpCameraParameters &cam_left, vpCameraParameters &cam_right)
+{
+  boost::mutex::scoped_lock lock(mutex_param);
+  while(!first_param_received)
+    cond_param.wait(lock);
+  if(_rectify){
+    const cv::Matx34d &Pl = rect_P[0];
+    const cv::Matx34d &Pr = rect_P[1];
+    cam_left.initPersProjWithoutDistortion(Pl(0,0), Pl(1,1), Pl(0,2), Pl(1,2));
+    cam_right.initPersProjWithoutDistortion(Pr(0,0), Pr(1,1), Pr(0,2), Pr(1,2));
+  }else{
+    cam_left = visp_bridge::toVispCameraParameters(left_info_msg);
+    cam_right = visp_bridge::toVispCameraParameters(right_info_msg);
+  }
+}
+
+
+/*!
+  Get the stereo baseline.
+
+  \return Baseline of the stereo rig in meters, or 0 if the CameraInfo are not received yet.
+*/
+double vpROSStereoGrabber::getBaseline()
+{
+  boost::mutex::scoped_lock lock(mutex_param);
+  if(!first_param_received)
+    return 0.;
+  return model.baseline();
+}
+
+
+/*!
+  Get the 4x4 disparity-to-depth reprojection matrix of the rectified pair
+  as expected by cv::reprojectImageTo3D(), in the pixels of the returned
+  images.
+
+  \param Q reprojection matrix, empty if the CameraInfo are not received yet.
+*/
+void vpROSStereoGrabber::getReprojectionMatrix(cv::Mat &Q)
+{
+  boost::mutex::scoped_lock lock(mutex_param);
+  if(!first_param_received){
+    Q.release();
+    return;
+  }
+  const cv::Matx34d &Pl = rect_P[0];
+  const cv::Matx34d &Pr = rect_P[1];
+  const double Tx = Pr(0,3) / Pr(0,0); // Minus the baseline
+  cv::Mat(cv::Matx44d(1., 0., 0.,       -Pl(0,2),
+                      0., 1., 0.,       -Pl(1,2),
+                      0., 0., 0.,       Pl(0,0),
+                      0., 0., -1. / Tx, (Pl(0,2) - Pr(0,2)) / Tx)).copyTo(Q);
+}
+
+
+/*!
+  Get the width of the images.
+
+  \return width of the images.
+*/
+unsigned short vpROSStereoGrabber::getWidth() const
+{
+  return usWidth;
+}
+
+
+/*!
+  Get the height of the images.
+
+  \return height of the images.
+*/
+unsigned short vpROSStereoGrabber::getHeight() const
+{
+  return usHeight;
+}
+
+
+void vpROSStereoGrabber::imageCallback(const sensor_msgs::Image::ConstPtr& left, const sensor_msgs::Image::ConstPtr& right)
+{
+  cv_bridge::CvImageConstPtr cv_ptr[2];
+  try
+  {
+    cv_ptr[0] = cv_bridge::toCvShare(left, "bgr8");
+    cv_ptr[1] = cv_bridge::toCvShare(right, "bgr8");
+  }
+  catch (cv_bridge::Exception& e)
+  {
+    ROS_ERROR("cv_bridge exception: %s", e.what());
+    return;
+  }
+
+  // Maps are never modified in place, sharing the headers is enough
+  cv::Mat m1[2], m2[2];
+  const bool rectify = _rectify;
+  if(rectify){
+    boost::mutex::scoped_lock lock(mutex_param);
+    if(!maps_valid){
+      ROS_WARN_THROTTLE(5., "vpROSStereoGrabber: no CameraInfo yet, stereo pair dropped");
+      return;
+    }
+    for(int i = 0; i < 2; i++){
+      m1[i] = map1[i];
+      m2[i] = map2[i];
+    }
+  }
+
+  if(rectify){
+    const cv::Mat src[2] = { cv_ptr[0]->image, cv_ptr[1]->image };
+    for(int i = 0; i < 2; i++){
+      if(src[i].size() != m1[i].size()){
+        ROS_WARN_THROTTLE(5., "vpROSStereoGrabber: %dx%d image does not match its CameraInfo, stereo pair dropped",
+                          src[i].cols, src[i].rows);
+        return;
+      }
+    }
+#if VISP_HAVE_OPENCV_VERSION >= 0x020403
+    cv::parallel_for_(cv::Range(0, 2), StereoRectifyBody(src, rect, m1, m2));
+#else
+    for(int i = 0; i < 2; i++)
+      cv::remap(src[i], rect[i], m1[i], m2[i], cv::INTER_LINEAR);
+#endif
+  }else{
+    for(int i = 0; i < 2; i++)
+      cv_ptr[i]->image.copyTo(rect[i]);
+  }
+
+  {
+    boost::mutex::scoped_lock lock(mutex_image);
+    for(int i = 0; i < 2; i++)
+      cv::swap(data[i], rect[i]);
+    usWidth = data[0].cols;
+    usHeight = data[0].rows;
+    _sec = left->header.stamp.sec;
+    _nsec = left->header.stamp.nsec;
+    first_img_received = true;
+  }
+  cond_image.notify_all();
+}
+
+
+void vpROSStereoGrabber::leftParamCallback(const sensor_msgs::CameraInfo::ConstPtr& msg)
+{
+  boost::mutex::scoped_lock lock(mutex_param);
+  if(left_info_received && sameCalibration(left_info_msg, *msg))
+    return;
+  left_info_msg = *msg;
+  left_info_received = true;
+  updateModel();
+}
+
+
+void vpROSStereoGrabber::rightParamCallback(const sensor_msgs::CameraInfo::ConstPtr& msg)
+{
+  boost::mutex::scoped_lock lock(mutex_param);
+  if(right_info_received && sameCalibration(right_info_msg, *msg))
+    return;
+  right_info_msg = *msg;
+  right_info_received = true;
+  updateModel();
+}
+
+
+/*!
+  Rebuild the stereo model and the cached rectification maps.
+  Called with mutex_param locked, only when one of the calibrations changed.
+*/
+void vpROSStereoGrabber::updateModel()
+{
+  if(!left_info_received || !right_info_received)
+    return;
+
+  model.fromCameraInfo(left_info_msg, right_info_msg);
+
+  const sensor_msgs::CameraInfo *info[2] = { &left_info_msg, &right_info_msg };
+  for(int i = 0; i < 2; i++){
+    // New buffers, the callback may still be remapping with the previous ones
+    cv::Mat m1, m2;
+    initRectifyMap(*info[i], m1, m2, rect_P[i]);
+    map1[i] = m1;
+    map2[i] = m2;
+  }
+  maps_valid = true;
+  first_param_received = true;
+  cond_param.notify_all();
+}
+
+#endif
@@ -0,0 +1,230 @@
+/****************************************************************************
+ *
+ * $Id: vpROSPipeline.cpp $
+ *
+ * This file is part of the ViSP software.
+ * Copyright (C) 2005 - 2014 by INRIA. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact INRIA about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://www.irisa.fr/lagadic/visp/visp.html for more information.
+ *
+ * This software was developed at:
+ * INRIA Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ * http://www.irisa.fr/lagadic
+ *
+ * If you have questions regarding the use of this file, please contact
+ * INRIA at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *
+ * Description:
+ * Staged image processing pipeline fed by vpROSGrabber.
+ *
+ * Authors:
+ * agent
+ *
+ *****************************************************************************/
+
+/*!
+  \file vpROSPipeline.cpp
+  \brief Staged image processing pipeline fed by vpROSGrabber.
+*/
+
+#include <visp_ros/vpROSPipeline.h>
+
+#if defined(VISP_HAVE_OPENCV)
+
+#include <visp/vpException.h>
+#include <boost/bind.hpp>
+#include <time.h>
+
+namespace {
+
+double monotonicTime()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+}
+
+/*!
+  Constructor.
+
+  \param g : Grabber used as source stage. It has to stay alive as long as the pipeline.
+*/
+vpROSPipeline::vpROSPipeline(vpROSGrabber &g) :
+  grabber(g),
+  seq(0),
+  running(false)
+{
+
+}
+
+
+/*!
+  Destructor. Stops the pipeline. The stages are not deleted.
+*/
+vpROSPipeline::~vpROSPipeline()
+{
+  stop();
+  for(size_t i = 0; i < stages.size(); i++)
+    delete stages[i];
+}
+
+
+/*!
+  Append a stage at the end of the pipeline.
+
+  \param stage : Stage to add. It is not deleted by the pipeline.
+
+  \param queue_size : Capacity of the queue feeding the stage.
+
+  \param policy : Behavior of the queue feeding the stage when it is full.
+
+  \exception vpException::fatalError : If the pipeline is running.
+*/
+void vpROSPipeline::addStage(vpROSPipelineStage *stage, unsigned int queue_size, vpOverflowPolicy policy)
+{
+  if(running)
+    throw(vpException(vpException::fatalError, "Cannot add a stage to a running pipeline"));
+  stages.push_back(new StageContext(stage, queue_size, policy));
+}
+
+
+/*!
+  Start a thread per stage and register the pipeline as frame callback of the grabber.
+*/
+void vpROSPipeline::start()
+{
+  if(running || stages.empty())
+    return;
+  running = true;
+  for(size_t i = 0; i < stages.size(); i++){
+    stages[i]->queue.open();
+    stages[i]->thread = new boost::thread(boost::bind(&vpROSPipeline::stageLoop, this, i));
+  }
+  grabber.setFrameCallback(boost::bind(&vpROSPipeline::sourceCallback, this, _1));
+}
+
+
+/*!
+  Unregister the pipeline from the grabber and join the stage threads.
+  Frames still queued are discarded.
+*/
+void vpROSPipeline::stop()
+{
+  if(!running)
+    return;
+  // Close the queues first to release a grabber worker blocked on a full queue
+  for(size_t i = 0; i < stages.size(); i++)
+    stages[i]->queue.close();
+  grabber.setFrameCallback(boost::function<void(const vpROSGrabber::Frame&)>());
+  for(size_t i = 0; i < stages.size(); i++){
+    stages[i]->thread->join();
+    delete stages[i]->thread;
+    stages[i]->thread = NULL;
+    vpROSPipelineFramePtr frame;
+    while(stages[i]->queue.tryPop(frame));
+  }
+  running = false;
+}
+
+
+/*!
+  Get the statistics of each stage, in the order they were added.
+
+  \param stats : Statistics of the stages.
+*/
+void vpROSPipeline::getStats(std::vector<vpROSPipelineStageStats> &stats)
+{
+  stats.resize(stages.size());
+  for(size_t i = 0; i < stages.size(); i++){
+    StageContext *ctx = stages[i];
+    vpROSPipelineStageStats &s = stats[i];
+    s.name = ctx->stage->getName();
+    s.dropped = ctx->queue.getDropped();
+    s.queue_depth = ctx->queue.size();
+    s.queue_capacity = ctx->queue.capacity();
+    boost::mutex::scoped_lock lock(ctx->stats_mutex);
+    s.processed = ctx->processed;
+    s.rejected = ctx->rejected;
+    s.latency_mean = ctx->processed ? ctx->latency_sum / ctx->processed : 0.;
+    s.latency_max = ctx->latency_max;
+    s.age_mean = ctx->processed ? ctx->age_sum / ctx->processed : 0.;
+  }
+}
+
+
+/*!
+  Reset the latency and counter statistics of all the stages.
+*/
+void vpROSPipeline::resetStats()
+{
+  for(size_t i = 0; i < stages.size(); i++){
+    boost::mutex::scoped_lock lock(stages[i]->stats_mutex);
+    stages[i]->reset();
+  }
+}
+
+
+void vpROSPipeline::sourceCallback(const vpROSGrabber::Frame &frame)
+{
+  vpROSPipelineFramePtr f(new vpROSPipelineFrame);
+  f->image = frame.image;
+  f->timestamp = frame.timestamp;
+  f->seq = seq++;
+  f->t_source = monotonicTime();
+  stages[0]->queue.push(f);
+}
+
+
+void vpROSPipeline::stageLoop(size_t index)
+{
+  StageContext *ctx = stages[index];
+  StageContext *next = (index + 1 < stages.size()) ? stages[index + 1] : NULL;
+  vpROSPipelineFramePtr frame;
+
+  while(ctx->queue.pop(frame)){
+    double t0 = monotonicTime();
+    bool forward = false;
+    try{
+      forward = ctx->stage->process(*frame);
+    }
+    catch(std::exception &e){
+      ROS_ERROR("vpROSPipeline stage %s exception: %s", ctx->stage->getName().c_str(), e.what());
+    }
+    double t1 = monotonicTime();
+    {
+      boost::mutex::scoped_lock lock(ctx->stats_mutex);
+      double latency = t1 - t0;
+      ctx->processed++;
+      ctx->latency_sum += latency;
+      if(latency > ctx->latency_max)
+        ctx->latency_max = latency;
+      ctx->age_sum += t1 - frame->t_source;
+      if(!forward)
+        ctx->rejected++;
+    }
+    if(forward && next)
+      next->queue.push(frame);
+    frame.reset();
+  }
+}
+
+#endif
@@ -43,14 +43,426 @@
 #include <visp/vpMath.h>
 #include <visp/vpRobotException.h>
 #include <visp_ros/vpROSRobotPioneer.h>
+#include <cmath>
+#include <cstring>
+#include <limits>
 
 
 /*!
   Default constructor that initializes Aria.
   */
-vpROSRobotPioneer::vpROSRobotPioneer() : vpPioneer()
+vpROSRobotPioneer::vpROSRobotPioneer() : vpPioneer(),
+  _use_laser(false),
+  _use_sonar(false),
+  _topic_laser("scan"),
+  _topic_sonar("sonar"),
+  laser_angle_min(0.f),
+  laser_angle_increment(0.f),
+  _safety(false),
+  _safety_stop(0.1),
+  _safety_slow(0.5),
+  _safety_scale(1.)
 {
+  _laser_pose[0] = _laser_pose[1] = _laser_pose[2] = 0.;
+  memset(&obstacle_state, 0, sizeof(obstacle_state));
+  for(unsigned int i = 0; i < 2; i++)
+    obstacle_state.ahead[i] = obstacle_state.behind[i] = std::numeric_limits<double>::max();
+  obstacle_lock.store(obstacle_state);
+  // vpROSRobot starts with an identity cMe, use the Pioneer camera mounting set by vpPioneer
+  vpROSRobot::set_cMe(vpUnicycle::get_cMe());
+}
+
+
+/*!
+  Destructor. Stops the current move and waits for the range sensor callbacks
+  before releasing their buffers.
+  */
+vpROSRobotPioneer::~vpROSRobotPioneer()
+{
+  // The position controller calls applyControllerVelocity() from the odometry callback
+  cancelPosition();
+  laser_sub.shutdown();
+  sonar_sub.shutdown();
+}
+
+
+/*!
+  Enable or disable sonar device usage. The sonar ranges are read from the
+  sensor_msgs::PointCloud "sonar" topic published by RosAria, in the robot frame.
+
+  \param usage : true to subscribe to the sonar.
+
+  \sa getNearestObstacle(), getObstacles()
+  */
+void vpROSRobotPioneer::useSonar(bool usage)
+{
+  _use_sonar = usage;
+  if(vpROSRobot::isInitialized)
+    subscribeSensors();
+}
+
+
+/*!
+  Enable or disable laser range finder usage.
+
+  \param usage : true to subscribe to the laser.
 
+  \param topic : sensor_msgs::LaserScan topic, relative to the robot namespace.
+
+  \sa setLaserPose(), getNearestObstacle(), getObstacles()
+  */
+void vpROSRobotPioneer::useLaser(bool usage, const std::string &topic)
+{
+  _use_laser = usage;
+  _topic_laser = topic;
+  if(vpROSRobot::isInitialized)
+    subscribeSensors();
+}
+
+
+/*!
+  Set the pose of the laser range finder in the robot frame.
+
+  \param x, y : Position of the laser in meters.
+
+  \param theta : Orientation of the laser in radians.
+  */
+void vpROSRobotPioneer::setLaserPose(double x, double y, double theta)
+{
+  boost::mutex::scoped_lock lock(sensor_mutex);
+  _laser_pose[0] = x;
+  _laser_pose[1] = y;
+  _laser_pose[2] = theta;
+  // Force the computation of the tables at the next scan
+  laser_cos.clear();
+}
+
+
+/*!
+  Get the obstacle closest to the robot origin among the last laser scan and
+  sonar readings. Lock-free, suited to a safety check in a control loop.
+
+  \param distance : Distance of the obstacle in meters.
+
+  \param x, y : Position of the obstacle in the robot frame.
+
+  \return false if no range data was received yet.
+  */
+bool vpROSRobotPioneer::getNearestObstacle(double &distance, double &x, double &y)
+{
+  vpROSObstacleState state;
+  obstacle_lock.load(state);
+  const vpROSNearestObstacle *nearest = NULL;
+  if(state.laser.valid)
+    nearest = &state.laser;
+  if(state.sonar.valid && (nearest == NULL || state.sonar.distance < nearest->distance))
+    nearest = &state.sonar;
+  if(nearest == NULL)
+    return false;
+  distance = nearest->distance;
+  x = nearest->x;
+  y = nearest->y;
+  return true;
+}
+
+
+/*!
+  Get a copy of the last laser and sonar points.
+
+  \param x, y : Coordinates of the points in the robot frame. Invalid laser
+  ranges are placed at a very large distance.
+  */
+void vpROSRobotPioneer::getObstacles(std::vector<float> &x, std::vector<float> &y)
+{
+  boost::mutex::scoped_lock lock(sensor_mutex);
+  x.assign(laser_x.begin(), laser_x.end());
+  x.insert(x.end(), sonar_x.begin(), sonar_x.end());
+  y.assign(laser_y.begin(), laser_y.end());
+  y.insert(y.end(), sonar_y.begin(), sonar_y.end());
+}
+
+
+/*!
+  Enable the reactive safety layer of setVelocity().
+
+  The laser and sonar points are accumulated in a small grid centered on the
+  robot, see vpROSObstacleGrid. At each setVelocity() call the arc followed
+  by the (v, w) command is checked in the grid over \e slow_distance. Both
+  velocities are scaled by the same factor, which keeps the curvature. The
+  factor is 1 if the arc is free over \e slow_distance, and decreases
+  linearly to 0 when the free distance drops to \e stop_distance. The check
+  costs one grid lookup per cell along the arc. When a scan is being
+  inserted in the grid, the check falls back on the nearest obstacle on the
+  side of the direction of travel instead of waiting. When the robot is
+  already closer than its radius to an obstacle, only the motions that move
+  away from it are allowed, so that the robot can always back off.
+
+  \param enable : Enable or disable the safety layer. useLaser() or useSonar()
+  have to be enabled to get range data.
+
+  \param stop_distance : Free distance in meters under which the robot stops.
+
+  \param slow_distance : Free distance in meters under which the robot slows down.
+
+  \sa setRobotRadius(), getSafetyScale()
+  */
+void vpROSRobotPioneer::setSafety(bool enable, double stop_distance, double slow_distance)
+{
+  boost::mutex::scoped_lock lock(sensor_mutex);
+  _safety = enable;
+  _safety_stop = (stop_distance > 0.) ? stop_distance : 0.;
+  _safety_slow = (slow_distance > _safety_stop) ? slow_distance : _safety_stop + grid.getResolution();
+  _safety_scale.store(1.);
+  grid.clear();
+}
+
+
+/*!
+  Set the radius of the robot used to inflate the obstacles. The obstacle
+  grid is cleared and filled again by the next scans.
+
+  \param radius : Radius in meters, 0.3 m by default.
+  */
+void vpROSRobotPioneer::setRobotRadius(double radius)
+{
+  boost::mutex::scoped_lock lock(sensor_mutex);
+  grid.setGeometry(grid.getSize(), grid.getResolution(), radius);
+}
+
+
+double vpROSRobotPioneer::safetyScale(double v, double w)
+{
+  boost::mutex::scoped_try_lock lock(sensor_mutex);
+  double free_distance;
+  if(lock.owns_lock())
+    free_distance = grid.getFreeDistance(v, w, _safety_slow);
+  else{
+    // A scan is being inserted: conservative check on the nearest obstacle
+    // on the side of the direction of travel, the robot moves away from the others
+    vpROSObstacleState state;
+    obstacle_lock.load(state);
+    const double *nearest = (v > 0.) ? state.ahead : state.behind;
+    free_distance = ((nearest[0] < nearest[1]) ? nearest[0] : nearest[1]) - grid.getRadius();
+    if(fabs(v) < 1e-6)
+      free_distance = _safety_slow;
+  }
+  double scale = (free_distance - _safety_stop) / (_safety_slow - _safety_stop);
+  return (scale < 0.) ? 0. : ((scale > 1.) ? 1. : scale);
+}
+
+
+/*!
+  Apply the velocity computed by the position controller, with the
+  saturations and the safety layer of setVelocity().
+
+  \param v : Translation velocity in m/s.
+  \param w : Rotation velocity in rad/s.
+  */
+void vpROSRobotPioneer::applyControllerVelocity(double v, double w)
+{
+  vpColVector vel(2);
+  vel[0] = v;
+  vel[1] = w;
+  setVelocity(vpRobot::REFERENCE_FRAME, vel);
+}
+
+
+void vpROSRobotPioneer::initCommunication()
+{
+  vpROSRobot::initCommunication();
+  subscribeSensors();
+}
+
+
+void vpROSRobotPioneer::subscribeSensors()
+{
+  // The sensors are received on the robot queue, next to the odometry
+  if(_use_laser && !laser_sub)
+    laser_sub = n->subscribe(_nodespace + _topic_laser, 1, &vpROSRobotPioneer::laserCallback, this, ros::TransportHints().tcpNoDelay());
+  else if(!_use_laser && laser_sub)
+    laser_sub.shutdown();
+  if(_use_sonar && !sonar_sub)
+    sonar_sub = n->subscribe(_nodespace + _topic_sonar, 1, &vpROSRobotPioneer::sonarCallback, this, ros::TransportHints().tcpNoDelay());
+  else if(!_use_sonar && sonar_sub)
+    sonar_sub.shutdown();
+}
+
+
+/*
+  Compute the direction of each beam in the robot frame. Only called when the
+  scan geometry or the laser pose changes.
+*/
+void vpROSRobotPioneer::updateLaserTables(const sensor_msgs::LaserScan &msg)
+{
+  size_t size = msg.ranges.size();
+  laser_cos.resize(size);
+  laser_sin.resize(size);
+  laser_x.resize(size);
+  laser_y.resize(size);
+  for(size_t i = 0; i < size; i++){
+    double a = _laser_pose[2] + msg.angle_min + i * msg.angle_increment;
+    laser_cos[i] = (float)cos(a);
+    laser_sin[i] = (float)sin(a);
+  }
+  laser_angle_min = msg.angle_min;
+  laser_angle_increment = msg.angle_increment;
+}
+
+
+void vpROSRobotPioneer::laserCallback(const sensor_msgs::LaserScan::ConstPtr &msg)
+{
+  boost::mutex::scoped_lock lock(sensor_mutex);
+  const size_t size = msg->ranges.size();
+  if(laser_cos.size() != size || laser_angle_min != msg->angle_min || laser_angle_increment != msg->angle_increment)
+    updateLaserTables(*msg);
+
+  // Branch free loops over plain arrays so that the compiler vectorizes them
+  const float *r = size ? &msg->ranges[0] : NULL;
+  const float *c = size ? &laser_cos[0] : NULL;
+  const float *s = size ? &laser_sin[0] : NULL;
+  float *px = size ? &laser_x[0] : NULL;
+  float *py = size ? &laser_y[0] : NULL;
+  const float rmin = msg->range_min, rmax = msg->range_max;
+  const float tx = (float)_laser_pose[0], ty = (float)_laser_pose[1];
+  const float far = 1e6f;
+  for(size_t i = 0; i < size; i++){
+    float ri = r[i];
+    // NaN fails both comparisons and is discarded as well
+    ri = (ri >= rmin && ri <= rmax) ? ri : far;
+    px[i] = tx + ri * c[i];
+    py[i] = ty + ri * s[i];
+  }
+
+  float dmin = std::numeric_limits<float>::max();
+  float dahead = dmin, dbehind = dmin;
+  size_t imin = 0;
+  for(size_t i = 0; i < size; i++){
+    float d = px[i] * px[i] + py[i] * py[i];
+    if(d < dmin){
+      dmin = d;
+      imin = i;
+    }
+    if(px[i] >= 0.f)
+      dahead = (d < dahead) ? d : dahead;
+    else
+      dbehind = (d < dbehind) ? d : dbehind;
+  }
+
+  obstacle_state.ahead[0] = (dahead < far * far * 0.25f) ? sqrt(dahead) : std::numeric_limits<double>::max();
+  obstacle_state.behind[0] = (dbehind < far * far * 0.25f) ? sqrt(dbehind) : std::numeric_limits<double>::max();
+  vpROSNearestObstacle &nearest = obstacle_state.laser;
+  nearest.valid = (size > 0 && dmin < far * far * 0.25f) ? 1 : 0;
+  nearest.distance = nearest.valid ? sqrt(dmin) : 0.;
+  nearest.x = nearest.valid ? px[imin] : 0.;
+  nearest.y = nearest.valid ? py[imin] : 0.;
+  nearest.sec = msg->header.stamp.sec;
+  nearest.nsec = msg->header.stamp.nsec;
+  obstacle_lock.store(obstacle_state);
+
+  if(_safety)
+    grid.update(0, px, py, size);
+}
+
+
+void vpROSRobotPioneer::sonarCallback(const sensor_msgs::PointCloud::ConstPtr &msg)
+{
+  boost::mutex::scoped_lock lock(sensor_mutex);
+  const size_t size = msg->points.size();
+  sonar_x.resize(size);
+  sonar_y.resize(size);
+  float dmin = std::numeric_limits<float>::max();
+  float dahead = dmin, dbehind = dmin;
+  size_t imin = 0;
+  for(size_t i = 0; i < size; i++){
+    sonar_x[i] = msg->points[i].x;
+    sonar_y[i] = msg->points[i].y;
+    float d = sonar_x[i] * sonar_x[i] + sonar_y[i] * sonar_y[i];
+    if(d < dmin){
+      dmin = d;
+      imin = i;
+    }
+    if(sonar_x[i] >= 0.f)
+      dahead = (d < dahead) ? d : dahead;
+    else
+      dbehind = (d < dbehind) ? d : dbehind;
+  }
+
+  obstacle_state.ahead[1] = (dahead < std::numeric_limits<float>::max()) ? sqrt(dahead) : std::numeric_limits<double>::max();
+  obstacle_state.behind[1] = (dbehind < std::numeric_limits<float>::max()) ? sqrt(dbehind) : std::numeric_limits<double>::max();
+
+  vpROSNearestObstacle &nearest = obstacle_state.sonar;
+  nearest.valid = (size > 0) ? 1 : 0;
+  nearest.distance = nearest.valid ? sqrt(dmin) : 0.;
+  nearest.x = nearest.valid ? sonar_x[imin] : 0.;
+  nearest.y = nearest.valid ? sonar_y[imin] : 0.;
+  nearest.sec = msg->header.stamp.sec;
+  nearest.nsec = msg->header.stamp.nsec;
+  obstacle_lock.store(obstacle_state);
+
+  if(_safety)
+    grid.update(1, size ? &sonar_x[0] : NULL, size ? &sonar_y[0] : NULL, size);
+}
+
+
+/*!
+  Get the robot velocity from the twist of the last odometry message.
+
+  \param frame : Control frame.
+  - vpRobot::REFERENCE_FRAME : first value is the translation velocity in m/s,
+    second value is the rotational velocity in rad/s, as for setVelocity().
+  - vpRobot::CAMERA_FRAME : 6 dimension twist of the camera,
+    see vpROSRobot::getVelocity().
+
+  \param velocity : Robot velocity.
+
+  \exception vpRobotException::wrongStateError : If the specified control frame
+  is not supported. The wheel velocities returned by vpRobotPioneer in
+  vpRobot::ARTICULAR_FRAME are not available from the odometry.
+  */
+void vpROSRobotPioneer::getVelocity(const vpRobot::vpControlFrameType frame, vpColVector &velocity)
+{
+  if (frame == vpRobot::ARTICULAR_FRAME)
+  {
+    throw vpRobotException (vpRobotException::wrongStateError,
+                            "Cannot get the wheel velocities from the odometry");
+  }
+  vpROSRobot::getVelocity(frame, velocity);
+  if (frame == vpRobot::REFERENCE_FRAME)
+  {
+    double v = velocity[0];
+    double w = velocity[5];
+    velocity.resize(2);
+    velocity[0] = v;
+    velocity[1] = w;
+  }
+}
+
+
+/*!
+  Get the robot velocity from the twist of the last odometry message.
+
+  \param frame : Control frame, see getVelocity(const vpRobot::vpControlFrameType, vpColVector &).
+
+  \return Robot velocity.
+  */
+vpColVector vpROSRobotPioneer::getVelocity(const vpRobot::vpControlFrameType frame)
+{
+  vpColVector velocity;
+  getVelocity(frame, velocity);
+  return velocity;
+}
+
+
+/*!
+  Set the transformation between the camera frame and the robot frame, used
+  by the unicycle model and to express the velocities in vpRobot::CAMERA_FRAME.
+
+  \param cMe : Robot frame in the camera frame.
+  */
+void vpROSRobotPioneer::set_cMe(const vpHomogeneousMatrix &cMe)
+{
+  vpUnicycle::set_cMe(cMe);
+  vpROSRobot::set_cMe(cMe);
 }
 
 
@@ -72,6 +484,29 @@ vpROSRobotPioneer::vpROSRobotPioneer() : vpPioneer()
   \exception vpRobotException::wrongStateError : If the specified control frame is not supported.
   */
 void vpROSRobotPioneer::setVelocity(const vpRobot::vpControlFrameType frame, const vpColVector &vel)
+{
+  struct timespec timestamp;
+  timestamp.tv_sec = 0;
+  timestamp.tv_nsec = 0;
+  setVelocity(frame, vel, timestamp);
+}
+
+
+/*!
+  Set the velocity (frame has to be specified) that will be applied to the
+  robot, with the stamp of the sensor data it was computed from, see
+  vpROSRobot::setVelocity(const vpRobot::vpControlFrameType, const vpColVector &, const struct timespec &).
+
+  \param frame : Control frame, see setVelocity(const vpRobot::vpControlFrameType, const vpColVector &).
+
+  \param vel : A two dimension vector with the translation and rotation velocities.
+
+  \param timestamp : ROS time of the data the command was computed from.
+
+  \exception vpRobotException::dimensionError : Velocity vector is not a 2 dimension vector.
+  \exception vpRobotException::wrongStateError : If the specified control frame is not supported.
+  */
+void vpROSRobotPioneer::setVelocity(const vpRobot::vpControlFrameType frame, const vpColVector &vel, const struct timespec &timestamp)
 {
   init();
 
@@ -90,13 +525,19 @@ void vpROSRobotPioneer::setVelocity(const vpRobot::vpControlFrameType frame, con
     vel_max[1] = getMaxRotationVelocity();
 
     vel_sat = vpRobot::saturateVelocities(vel, vel_max, true);
+    if (_safety)
+    {
+      double scale = safetyScale(vel_sat[0], vel_sat[1]);
+      _safety_scale.store(scale);
+      vel_sat *= scale;
+    }
     vel_robot[0] = vel_sat[0];
-    vel_robot[0] = 0;
-    vel_robot[0] = 0;
-    vel_robot[0] = 0;
-    vel_robot[0] = 0;
-    vel_robot[0] = vel_sat[1];
-    vpROSRobot::setVelocity(frame, vel_robot);
+    vel_robot[1] = 0;
+    vel_robot[2] = 0;
+    vel_robot[3] = 0;
+    vel_robot[4] = 0;
+    vel_robot[5] = vel_sat[1];
+    vpROSRobot::setVelocity(frame, vel_robot, timestamp);
   }
   else
   {
@@ -0,0 +1,306 @@
+/****************************************************************************
+ *
+ * $Id: vpROSSimulatedBase.cpp $
+ *
+ * This file is part of the ViSP software.
+ * Copyright (C) 2005 - 2014 by INRIA. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact INRIA about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://www.irisa.fr/lagadic/visp/visp.html for more information.
+ *
+ * This software was developed at:
+ * INRIA Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ * http://www.irisa.fr/lagadic
+ *
+ * If you have questions regarding the use of this file, please contact
+ * INRIA at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *
+ * Description:
+ * Simulated mobile base publishing odometry from velocity commands.
+ *
+ * Authors:
+ * agent
+ *
+ *****************************************************************************/
+
+/*!
+  \file vpROSSimulatedBase.cpp
+  \brief Simulated mobile base publishing odometry from velocity commands.
+*/
+
+#include <visp_ros/vpROSSimulatedBase.h>
+#include <visp/vpRobotException.h>
+#include <boost/bind.hpp>
+#include <cmath>
+#include <errno.h>
+#include <time.h>
+
+namespace {
+
+double monotonicTime()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)t.tv_sec + (double)t.tv_nsec / 1000000000.0;
+}
+
+/*
+  Integrate a body frame planar twist (vx, vy, wz) over dt with the mid-point
+  heading, accurate enough for the small steps of the simulation.
+*/
+void integrate(double pose[3], const double v[3], double dt)
+{
+  double theta = pose[2] + 0.5 * v[2] * dt;
+  double c = cos(theta), s = sin(theta);
+  pose[0] += (c * v[0] - s * v[1]) * dt;
+  pose[1] += (s * v[0] + c * v[1]) * dt;
+  pose[2] = atan2(sin(pose[2] + v[2] * dt), cos(pose[2] + v[2] * dt));
+}
+
+}
+
+/*!
+  Default constructor. The base is a unicycle publishing odometry at 50 Hz
+  with no latency and no noise on the "cmd_vel" and "odom" topics.
+*/
+vpROSSimulatedBase::vpROSSimulatedBase() :
+  n(NULL),
+  thread(NULL),
+  running(false),
+  noise_linear(0., 0.),
+  noise_angular(0., 0.),
+  _model(UNICYCLE),
+  _rate(50.),
+  _latency(0.),
+  _noise_linear(0.),
+  _noise_angular(0.),
+  _cmd_stamped(false),
+  _nodespace(""),
+  _topic_cmd("cmd_vel"),
+  _topic_odom("odom")
+{
+  for(unsigned int i = 0; i < 3; i++)
+    pose[i] = odom_pose[i] = 0.;
+}
+
+/*!
+  Destructor. Stops the simulation.
+*/
+vpROSSimulatedBase::~vpROSSimulatedBase()
+{
+  stop();
+}
+
+/*!
+  Set the odometry publishing rate, which is also the integration rate.
+  Has to be called before start().
+
+  \param hz : Rate in Hz.
+*/
+void vpROSSimulatedBase::setRate(double hz)
+{
+  if(running)
+    throw vpRobotException(vpRobotException::wrongStateError, "Cannot change the rate of a running simulated base");
+  _rate = (hz > 0.) ? hz : 50.;
+}
+
+/*!
+  Set the delay between the reception of a velocity command and its effect on the base.
+
+  \param latency : Latency in seconds.
+*/
+void vpROSSimulatedBase::setLatency(double latency)
+{
+  _latency = (latency > 0.) ? latency : 0.;
+}
+
+/*!
+  Set the standard deviation of the gaussian noise added to the twist
+  published in the odometry. The published pose is integrated from this
+  noisy twist and therefore drifts from the ground truth given by getPose().
+  Has to be called before start().
+
+  \param linear : Standard deviation of the linear velocities in m/s.
+
+  \param angular : Standard deviation of the angular velocity in rad/s.
+*/
+void vpROSSimulatedBase::setNoise(double linear, double angular)
+{
+  if(running)
+    throw vpRobotException(vpRobotException::wrongStateError, "Cannot change the noise of a running simulated base");
+  _noise_linear = (linear > 0.) ? linear : 0.;
+  _noise_angular = (angular > 0.) ? angular : 0.;
+  noise_linear.setSigmaMean(_noise_linear, 0.);
+  noise_angular.setSigmaMean(_noise_angular, 0.);
+}
+
+/*!
+  Select the type of the velocity commands. Has to be called before start().
+
+  \param stamped : If true, subscribe to geometry_msgs::TwistStamped commands as
+  published by a vpROSRobot with vpROSRobot::setCommandStamped(true), else
+  to geometry_msgs::Twist commands (default).
+*/
+void vpROSSimulatedBase::setCommandStamped(bool stamped)
+{
+  if(running)
+    throw vpRobotException(vpRobotException::wrongStateError, "Cannot change the command type of a running simulated base");
+  _cmd_stamped = stamped;
+}
+
+/*!
+  Get the ground truth pose of the base.
+
+  \param x, y : Position in meters.
+  \param theta : Heading in radians.
+*/
+void vpROSSimulatedBase::getPose(double &x, double &y, double &theta)
+{
+  boost::mutex::scoped_lock lock(pose_mutex);
+  x = pose[0];
+  y = pose[1];
+  theta = pose[2];
+}
+
+/*!
+  Move the base. Both the ground truth and the odometry are reset to this pose.
+
+  \param x, y : Position in meters.
+  \param theta : Heading in radians.
+*/
+void vpROSSimulatedBase::setPose(double x, double y, double theta)
+{
+  boost::mutex::scoped_lock lock(pose_mutex);
+  pose[0] = odom_pose[0] = x;
+  pose[1] = odom_pose[1] = y;
+  pose[2] = odom_pose[2] = theta;
+}
+
+/*!
+  Subscribe to the command topic, advertise the odometry and start the
+  simulation thread. ros::init() has to be called before.
+*/
+void vpROSSimulatedBase::start()
+{
+  if(running)
+    return;
+  if(!ros::isInitialized())
+    throw vpRobotException(vpRobotException::constructionError, "ROS has to be initialized before starting a simulated base");
+  n = new ros::NodeHandle;
+  n->setCallbackQueue(&queue);
+  odom_pub = n->advertise<nav_msgs::Odometry>(_nodespace + _topic_odom, 1);
+  if(_cmd_stamped)
+    cmd_sub = n->subscribe(_nodespace + _topic_cmd, 1, &vpROSSimulatedBase::cmdStampedCallback, this, ros::TransportHints().tcpNoDelay());
+  else
+    cmd_sub = n->subscribe(_nodespace + _topic_cmd, 1, &vpROSSimulatedBase::cmdCallback, this, ros::TransportHints().tcpNoDelay());
+  commands.clear();
+  running = true;
+  thread = new boost::thread(boost::bind(&vpROSSimulatedBase::loop, this));
+}
+
+/*!
+  Stop the simulation thread and unsubscribe.
+*/
+void vpROSSimulatedBase::stop()
+{
+  if(!running)
+    return;
+  running = false;
+  thread->join();
+  delete thread;
+  thread = NULL;
+  cmd_sub.shutdown();
+  odom_pub.shutdown();
+  delete n;
+  n = NULL;
+}
+
+void vpROSSimulatedBase::cmdCallback(const geometry_msgs::Twist::ConstPtr &msg)
+{
+  pushCommand(*msg);
+}
+
+void vpROSSimulatedBase::cmdStampedCallback(const geometry_msgs::TwistStamped::ConstPtr &msg)
+{
+  pushCommand(msg->twist);
+}
+
+void vpROSSimulatedBase::pushCommand(const geometry_msgs::Twist &twist)
+{
+  Command c;
+  c.t = monotonicTime() + _latency;
+  c.v[0] = twist.linear.x;
+  c.v[1] = (_model == HOLONOMIC) ? twist.linear.y : 0.;
+  c.v[2] = twist.angular.z;
+  commands.push_back(c);
+}
+
+void vpROSSimulatedBase::loop()
+{
+  const long period_ns = (long)(1000000000.0 / _rate);
+  double v[3] = {0., 0., 0.};
+  double t_prev = monotonicTime();
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+  nav_msgs::Odometry odom;
+  odom.header.frame_id = _nodespace + "odom";
+  odom.child_frame_id = _nodespace + "base_link";
+
+  while(running && n->ok()){
+    deadline.tv_nsec += period_ns;
+    while(deadline.tv_nsec >= 1000000000L){
+      deadline.tv_nsec -= 1000000000L;
+      deadline.tv_sec++;
+    }
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR);
+
+    // The command callback runs in this thread
+    queue.callAvailable();
+
+    double t = monotonicTime();
+    double dt = t - t_prev;
+    t_prev = t;
+    while(!commands.empty() && commands.front().t <= t){
+      for(unsigned int i = 0; i < 3; i++)
+        v[i] = commands.front().v[i];
+      commands.pop_front();
+    }
+
+    double v_meas[3];
+    v_meas[0] = v[0] + noise_linear();
+    v_meas[1] = (_model == HOLONOMIC) ? v[1] + noise_linear() : 0.;
+    v_meas[2] = v[2] + noise_angular();
+
+    {
+      boost::mutex::scoped_lock lock(pose_mutex);
+      integrate(pose, v, dt);
+      integrate(odom_pose, v_meas, dt);
+      odom.pose.pose.position.x = odom_pose[0];
+      odom.pose.pose.position.y = odom_pose[1];
+      odom.pose.pose.orientation.z = sin(0.5 * odom_pose[2]);
+      odom.pose.pose.orientation.w = cos(0.5 * odom_pose[2]);
+    }
+    odom.twist.twist.linear.x = v_meas[0];
+    odom.twist.twist.linear.y = v_meas[1];
+    odom.twist.twist.angular.z = v_meas[2];
+    odom.header.stamp = ros::Time::now();
+    odom_pub.publish(odom);
+  }
+}
@@ -0,0 +1,254 @@
+/****************************************************************************
+ *
+ * $Id: vpROSObstacleGrid.cpp $
+ *
+ * This file is part of the ViSP software.
+ * Copyright (C) 2005 - 2014 by INRIA. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact INRIA about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://www.irisa.fr/lagadic/visp/visp.html for more information.
+ *
+ * This software was developed at:
+ * INRIA Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ * http://www.irisa.fr/lagadic
+ *
+ * If you have questions regarding the use of this file, please contact
+ * INRIA at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *
+ * Description:
+ * Robot centered grid of inflated obstacles.
+ *
+ * Authors:
+ * agent
+ *
+ *****************************************************************************/
+
+/*!
+  \file vpROSObstacleGrid.cpp
+  \brief Robot centered grid of inflated obstacles.
+*/
+
+#include <visp_ros/vpROSObstacleGrid.h>
+#include <cmath>
+#include <limits>
+
+/*!
+  Constructor.
+
+  \param size : Side of the grid in meters, centered on the robot.
+  \param resolution : Side of a cell in meters.
+  \param radius : Radius of the robot in meters.
+*/
+vpROSObstacleGrid::vpROSObstacleGrid(double size, double resolution, double radius)
+{
+  setGeometry(size, resolution, radius);
+}
+
+/*!
+  Change the geometry of the grid. The grid is cleared.
+
+  \param size : Side of the grid in meters, centered on the robot.
+  \param resolution : Side of a cell in meters.
+  \param radius : Radius of the robot in meters.
+*/
+void vpROSObstacleGrid::setGeometry(double size, double resolution, double radius)
+{
+  _resolution = (resolution > 0.) ? resolution : 0.05;
+  _radius = (radius > 0.) ? radius : 0.;
+  _cells_per_side = (int)ceil(((size > 0.) ? size : 4.) / _resolution);
+  cells.assign((size_t)(_cells_per_side * _cells_per_side), 0);
+
+  int r = (int)ceil(_radius / _resolution);
+  disk_dx.clear();
+  disk_dy.clear();
+  for(int dy = -r; dy <= r; dy++){
+    for(int dx = -r; dx <= r; dx++){
+      if((dx * dx + dy * dy) * _resolution * _resolution <= _radius * _radius){
+        disk_dx.push_back(dx);
+        disk_dy.push_back(dy);
+      }
+    }
+  }
+  for(size_t i = 0; i < marked.size(); i++)
+    marked[i].clear();
+}
+
+/*!
+  Remove all the obstacles.
+*/
+void vpROSObstacleGrid::clear()
+{
+  cells.assign(cells.size(), 0);
+  for(size_t i = 0; i < marked.size(); i++)
+    marked[i].clear();
+}
+
+/*!
+  Replace the obstacle points of a source.
+
+  \param source : Index of the source, for example 0 for a laser and 1 for the sonar.
+  \param x, y : Coordinates of the points in the robot frame, in meters.
+  Points outside the grid are ignored.
+  \param n : Number of points.
+*/
+void vpROSObstacleGrid::update(unsigned int source, const float *x, const float *y, size_t n)
+{
+  if(source >= marked.size())
+    marked.resize(source + 1);
+  std::vector<int> &m = marked[source];
+  for(size_t i = 0; i < m.size(); i++)
+    mark(m[i], -1);
+  m.clear();
+  for(size_t i = 0; i < n; i++){
+    int cell = cellIndex(x[i], y[i]);
+    if(cell >= 0){
+      mark(cell, 1);
+      m.push_back(cell);
+    }
+  }
+}
+
+/*!
+  Check whether the robot centered at a position overlaps an obstacle.
+
+  \param x, y : Position of the robot center in the current robot frame.
+  \return true if an obstacle is within the robot radius. Positions outside
+  the grid are considered free.
+*/
+bool vpROSObstacleGrid::isOccupied(double x, double y) const
+{
+  int cell = cellIndex(x, y);
+  return (cell >= 0) && (cells[(size_t)cell] > 0);
+}
+
+/*!
+  Distance the robot can travel along the arc of a (v, w) command before
+  colliding. The cost is one cell lookup per resolution step along the arc.
+
+  When the robot already overlaps some obstacles, the arc is free as long as
+  it moves away from all of them, so that the robot can always back off.
+  Other obstacles are checked as usual.
+
+  \param v : Translation velocity in m/s. Its sign gives the direction of travel.
+  \param w : Rotation velocity in rad/s.
+  \param max_distance : Length of the checked part of the arc in meters.
+  \return Free distance in meters, max_distance if the arc is free.
+*/
+double vpROSObstacleGrid::getFreeDistance(double v, double w, double max_distance) const
+{
+  if(fabs(v) < 1e-6)
+    return max_distance; // A rotation in place does not sweep any new cell
+  double sign = (v > 0.) ? 1. : -1.;
+  bool straight = fabs(w) < 1e-6;
+  double R = straight ? 0. : v / w;
+
+  // Obstacle points already within the robot radius, only searched when the robot overlaps one
+  std::vector<int> overlapping;
+  int origin = cellIndex(0., 0.);
+  if(origin >= 0 && cells[(size_t)origin] > 0){
+    for(size_t k = 0; k < marked.size(); k++)
+      for(size_t i = 0; i < marked[k].size(); i++)
+        if(covers(marked[k][i], origin))
+          overlapping.push_back(marked[k][i]);
+  }
+  double clearance = distanceTo(overlapping, 0., 0.);
+
+  for(double s = 0.; s <= max_distance; s += _resolution){
+    double x, y;
+    if(straight){
+      x = sign * s;
+      y = 0.;
+    }
+    else{
+      double phi = sign * s / R;
+      x = R * sin(phi);
+      y = R * (1. - cos(phi));
+    }
+    int cell = cellIndex(x, y);
+    if(cell < 0)
+      continue;
+    unsigned int count = cells[(size_t)cell];
+    if(!overlapping.empty()){
+      double d = distanceTo(overlapping, x, y);
+      if(d < clearance)
+        return (s > _resolution) ? s - _resolution : 0.;
+      clearance = d;
+      for(size_t i = 0; i < overlapping.size() && count > 0; i++)
+        if(covers(overlapping[i], cell))
+          count--;
+    }
+    if(count > 0)
+      return s;
+  }
+  return max_distance;
+}
+
+/*
+  Whether the disk marked around the obstacle point of a cell covers another cell.
+*/
+bool vpROSObstacleGrid::covers(int point, int cell) const
+{
+  int dx = cell % _cells_per_side - point % _cells_per_side;
+  int dy = cell / _cells_per_side - point / _cells_per_side;
+  return (dx * dx + dy * dy) * _resolution * _resolution <= _radius * _radius;
+}
+
+/*
+  Distance from a position to the nearest center of a list of cells, a very
+  large value for an empty list.
+*/
+double vpROSObstacleGrid::distanceTo(const std::vector<int> &points, double x, double y) const
+{
+  double half = 0.5 * _cells_per_side;
+  double d2 = std::numeric_limits<double>::max();
+  for(size_t i = 0; i < points.size(); i++){
+    double dx = (points[i] % _cells_per_side + 0.5 - half) * _resolution - x;
+    double dy = (points[i] / _cells_per_side + 0.5 - half) * _resolution - y;
+    if(dx * dx + dy * dy < d2)
+      d2 = dx * dx + dy * dy;
+  }
+  return points.empty() ? d2 : sqrt(d2);
+}
+
+int vpROSObstacleGrid::cellIndex(double x, double y) const
+{
+  double half = 0.5 * _cells_per_side;
+  int i = (int)floor(x / _resolution + half);
+  int j = (int)floor(y / _resolution + half);
+  if(i < 0 || j < 0 || i >= _cells_per_side || j >= _cells_per_side)
+    return -1;
+  return j * _cells_per_side + i;
+}
+
+void vpROSObstacleGrid::mark(int cell, int delta)
+{
+  int i = cell % _cells_per_side;
+  int j = cell / _cells_per_side;
+  for(size_t k = 0; k < disk_dx.size(); k++){
+    int ii = i + disk_dx[k];
+    int jj = j + disk_dy[k];
+    if(ii < 0 || jj < 0 || ii >= _cells_per_side || jj >= _cells_per_side)
+      continue;
+    unsigned int &c = cells[(size_t)(jj * _cells_per_side + ii)];
+    if(delta > 0)
+      c++;
+    else if(c > 0)
+      c--;
+  }
+}
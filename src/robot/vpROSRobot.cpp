@@ -46,6 +46,8 @@
 */
 
 #include <visp/vpHomogeneousMatrix.h>
+#include <visp/vpExponentialMap.h>
+#include <visp/vpThetaUVector.h>
 #include <visp/vpRobotException.h>
 #include <visp_ros/vpROSRobot.h>
 #include <visp/vpDebug.h>
@@ -53,6 +55,12 @@
 #include <ros/ros.h>
 #include <ros/time.h>
 #include <sstream>
+#include <cstring>
+#include <cmath>
+#include <time.h>
+#include <errno.h>
+#include <sched.h>
+#include <boost/bind.hpp>
 
 /**
  * \def MIN(x,y)
@@ -72,24 +80,156 @@
  */
 #define CLIP(X,A,B) (MIN(MAX(X,A),B))
 
+namespace {
+
+// Odometry subscriber queue, also the longest burst integrated at once
+const unsigned int odom_queue_size = 16;
+
+/*
+  Convert a position and a quaternion in a (x, y, z, rx, ry, rz) pose vector.
+*/
+void toPose(const double p[3], const double q[4], vpColVector &pose)
+{
+  pose.resize(6);
+  pose[0] = p[0];
+  pose[1] = p[1];
+  pose[2] = p[2];
+  vpRotationMatrix R(vpQuaternionVector(q[0], q[1], q[2], q[3]));
+  vpRxyzVector V(R);
+  pose[3] = V[0];
+  pose[4] = V[1];
+  pose[5] = V[2];
+}
+
+double monotonicTime()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)t.tv_sec + (double)t.tv_nsec / 1000000000.0;
+}
+
+/*
+  Copy a homogeneous matrix in plain arrays and back.
+*/
+void toArrays(const vpHomogeneousMatrix &M, double R[9], double t[3])
+{
+  for(unsigned int i = 0; i < 3; i++){
+    for(unsigned int j = 0; j < 3; j++)
+      R[3*i+j] = M[i][j];
+    t[i] = M[i][3];
+  }
+}
+
+void fromArrays(const double R[9], const double t[3], vpHomogeneousMatrix &M)
+{
+  for(unsigned int i = 0; i < 3; i++){
+    for(unsigned int j = 0; j < 3; j++)
+      M[i][j] = R[3*i+j];
+    M[i][3] = t[i];
+  }
+}
+
+/*
+  Rebuild an orthonormal rotation to avoid the drift of long products.
+*/
+void orthonormalize(vpHomogeneousMatrix &M)
+{
+  vpRotationMatrix R;
+  vpTranslationVector t;
+  M.extract(R);
+  M.extract(t);
+  R.buildFrom(vpThetaUVector(R));
+  M.buildFrom(t, R);
+}
+
+/*
+  Spherical linear interpolation between unit quaternions q0 (s = 0) and q1 (s = 1).
+*/
+void slerp(const double q0[4], const double q1[4], double s, double q[4])
+{
+  double dot = q0[0]*q1[0] + q0[1]*q1[1] + q0[2]*q1[2] + q0[3]*q1[3];
+  double sign = 1.;
+  if(dot < 0.){ // take the shortest path
+    dot = -dot;
+    sign = -1.;
+  }
+  double a, b;
+  if(dot > 0.9995){ // nearly parallel, linear interpolation is accurate enough
+    a = 1. - s;
+    b = s;
+  }else{
+    double theta0 = acos(dot);
+    double sin0 = sin(theta0);
+    a = sin((1. - s) * theta0) / sin0;
+    b = sin(s * theta0) / sin0;
+  }
+  b *= sign;
+  double norm = 0.;
+  for(unsigned int i = 0; i < 4; i++){
+    q[i] = a * q0[i] + b * q1[i];
+    norm += q[i] * q[i];
+  }
+  norm = sqrt(norm);
+  for(unsigned int i = 0; i < 4; i++)
+    q[i] /= norm;
+}
+
+}
+
 
 
 //! constructor
 vpROSRobot::vpROSRobot():
+    n(NULL),
+    own_node(true),
+    queue(NULL),
+    spin_thread(NULL),
+    cmd_thread(NULL),
+    spin_running(false),
+    _spin_priority(0),
+    _spin_cpu(-1),
     isInitialized(false),
-    odom_mutex(true),
-    q(0,0,0,1),
-    p(0,0,0),
-    _sec(0),
-    _nsec(0),
-    displacement(6),
-    pose_prev(6),
+    odom_history(256),
+    odom_history_count(0),
+    _prediction(PREDICTION_NONE),
+    _prediction_max_horizon(0.2),
+    _prediction_horizon(0.),
+    cmd_running(false),
+    _cmd_stamped(false),
+    _cmd_frame("base_link"),
+    _cmd_rate(0.),
+    _cmd_timeout(0.),
+    _max_acc_linear(0.),
+    _max_acc_angular(0.),
+    _latency_enabled(false),
+    _latency_step(0.05),
+    _latency_timeout(1.),
+    latency_seq(0),
+    latency_done(0),
+    latency_count(0),
+    pos_active(false),
+    pos_aligning(false),
+    _pos_tolerance(0.05),
+    _pos_angle_tolerance(0.05),
+    _pos_max_v(0.3),
+    _pos_max_w(0.5),
     _master_uri("http://127.0.0.1:11311"),
     _topic_cmd("cmd_vel"),
     _topic_odom("odom"),
     _nodespace("")
 {
-
+    memset(&odom_state, 0, sizeof(odom_state));
+    odom_state.q[3] = 1.;
+    toArrays(odom_disp, odom_state.disp_R, odom_state.disp_t);
+    odom_lock.store(odom_state);
+    odom_burst_v.reserve(odom_queue_size);
+    odom_burst_dt.reserve(odom_queue_size);
+    set_cMe(vpHomogeneousMatrix());
+    memset(&cmd, 0, sizeof(cmd));
+    cmd_lock.store(cmd);
+    memset(&cmd_stats, 0, sizeof(cmd_stats));
+    memset(latency_last_cmd, 0, sizeof(latency_last_cmd));
+    setLatencyMeasurement(false);
 }
 
 
@@ -99,9 +239,27 @@ vpROSRobot::~vpROSRobot()
 {
     if(isInitialized){
         isInitialized = false;
-        spinner->stop();
-        delete spinner;
-        delete n;
+        {
+            // Wake up the threads waiting for a move
+            boost::mutex::scoped_lock lock(pos_mutex);
+            if(pos_active)
+                finishPosition(false);
+        }
+        stopCommandThread();
+        // Waits for a running odometry callback, also on a shared queue, and
+        // unregisters the subscriber while its private queue still exists
+        odom.shutdown();
+        if(spin_thread){
+            spin_running.store(false, boost::memory_order_release);
+            spin_thread->join();
+            delete spin_thread;
+            spin_thread = NULL;
+            delete queue;
+            queue = NULL;
+        }
+        if(own_node)
+            delete n;
+        n = NULL;
     }
 }
 
@@ -114,13 +272,57 @@ void vpROSRobot::init(int argc, char **argv)
 {
     if(!isInitialized){
         if(!ros::isInitialized()) ros::init(argc, argv, "visp_node", ros::init_options::AnonymousName);
+        // The odometry has its own queue and thread so that the callbacks of
+        // the global queue (image decoding...) do not delay it
+        queue = new ros::CallbackQueue;
+        initCommunication();
+        spin_running.store(true, boost::memory_order_release);
+        spin_thread = new boost::thread(boost::bind(&vpROSRobot::spinLoop, this));
+        if(_cmd_rate > 0.)
+            startCommandThread();
+    }
+}
+
+/*!
+  Initialisation on a node handle shared by several robots, as in
+  vpROSRobotGroup. The callbacks are registered on the callback queue of the
+  node handle, which is served by the caller. No thread is created by the
+  robot to receive the odometry.
+
+  \param shared_node : Node handle of the robot topics. It has to outlive the
+  robot, which does not delete it.
+
+  \exception vpRobotException::constructionError : If ROS is not initialized.
+  */
+void vpROSRobot::init(ros::NodeHandle *shared_node)
+{
+    if(isInitialized)
+        return;
+    if(!ros::isInitialized()){
+        throw (vpRobotException(vpRobotException::constructionError,
+                                "ROS has to be initialised before using a shared callback queue"));
+    }
+    n = shared_node;
+    own_node = false;
+    initCommunication();
+    if(_cmd_rate > 0.)
+        startCommandThread();
+}
+
+void vpROSRobot::initCommunication()
+{
+    if(n == NULL){
         n = new ros::NodeHandle;
-        cmdvel = n->advertise<geometry_msgs::Twist>(_nodespace + _topic_cmd, 1);
-        odom = n->subscribe(_nodespace + _topic_odom, 1, &vpROSRobot::odomCallback,this,ros::TransportHints().tcpNoDelay());
-        spinner = new ros::AsyncSpinner(1);
-        spinner->start();
-        isInitialized = true;
+        n->setCallbackQueue(queue);
     }
+    cmd_frame_id = _nodespace + _cmd_frame;
+    if(_cmd_stamped)
+        cmdvel = n->advertise<geometry_msgs::TwistStamped>(_nodespace + _topic_cmd, 1);
+    else
+        cmdvel = n->advertise<geometry_msgs::Twist>(_nodespace + _topic_cmd, 1);
+    // Queue a burst of odometry messages instead of dropping it, each one is integrated over its own interval
+    odom = n->subscribe(_nodespace + _topic_odom, odom_queue_size, &vpROSRobot::odomCallback,this,ros::TransportHints().tcpNoDelay());
+    isInitialized = true;
 }
 
 /*!
@@ -128,49 +330,556 @@ void vpROSRobot::init(int argc, char **argv)
 
   */
 void vpROSRobot::init(){
+    if(isInitialized)
+        return;
     if(ros::isInitialized() && ros::master::getURI() != _master_uri){
         throw (vpRobotException(vpRobotException::constructionError,
                                        "ROS already initialised with a different master_URI (" + ros::master::getURI() +" != " + _master_uri + ")") );
     }
-    if(!isInitialized){
-        int argc = 2;
-        char *argv[2];
-        std::string exe = "ros.exe", arg1 = "__master:=";
-        strcpy(argv[0], exe.c_str());
-        arg1.append(_master_uri);
-        strcpy(argv[1], arg1.c_str());
-        init(argc, argv);
-    }
+    int argc = 2;
+    std::string exe = "ros.exe", arg1 = "__master:=" + _master_uri;
+    // ros::init() may modify argv, give it writable copies
+    std::vector<char> exe_buf(exe.begin(), exe.end()), arg1_buf(arg1.begin(), arg1.end());
+    exe_buf.push_back('\0');
+    arg1_buf.push_back('\0');
+    char *argv[2] = { &exe_buf[0], &arg1_buf[0] };
+    init(argc, argv);
+}
+
+
+/*!
+  Set the real-time priority of the thread running the odometry callback.
+
+  \param priority : SCHED_FIFO priority (1 to 99). 0 restores the default
+  scheduling policy. Raising the priority usually requires the CAP_SYS_NICE
+  capability; a failure is reported as a ROS warning.
+  */
+void vpROSRobot::setSpinnerPriority(int priority)
+{
+  _spin_priority = (priority > 0) ? priority : 0;
+  if(spin_thread)
+    applySpinnerScheduling(spin_thread->native_handle());
+}
+
+
+/*!
+  Pin the thread running the odometry callback on a CPU.
+
+  \param cpu : Index of the CPU, -1 to allow all the CPUs.
+  */
+void vpROSRobot::setSpinnerAffinity(int cpu)
+{
+  _spin_cpu = cpu;
+  if(spin_thread)
+    applySpinnerScheduling(spin_thread->native_handle());
+}
+
+
+void vpROSRobot::applySpinnerScheduling(pthread_t thread)
+{
+  struct sched_param param;
+  param.sched_priority = _spin_priority;
+  int policy = (_spin_priority > 0) ? SCHED_FIFO : SCHED_OTHER;
+  if(pthread_setschedparam(thread, policy, &param) != 0)
+    ROS_WARN("vpROSRobot: cannot set the odometry thread priority to %d", _spin_priority);
+
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  if(_spin_cpu >= 0)
+    CPU_SET(_spin_cpu, &cpus);
+  else{
+    for(int i = 0; i < CPU_SETSIZE; i++)
+      CPU_SET(i, &cpus);
+  }
+  if(pthread_setaffinity_np(thread, sizeof(cpus), &cpus) != 0)
+    ROS_WARN("vpROSRobot: cannot pin the odometry thread on CPU %d", _spin_cpu);
+}
+
+
+void vpROSRobot::spinLoop()
+{
+  if(_spin_priority > 0 || _spin_cpu >= 0)
+    applySpinnerScheduling(pthread_self());
+  while(spin_running.load(boost::memory_order_acquire) && n->ok())
+    queue->callAvailable(ros::WallDuration(0.01));
 }
 
 
 /*!
   Set the velocity (frame has to be specified) that will be applied to the robot.
 
-  \param frame : Control frame. For the moment, only vpRobot::REFERENCE_FRAME is implemented.
+  \param frame : Control frame.
+  - vpRobot::REFERENCE_FRAME and vpRobot::ARTICULAR_FRAME : twist of the
+    robot expressed in its own frame, published as is.
+  - vpRobot::CAMERA_FRAME : twist of the camera expressed in the camera frame.
+  - vpRobot::MIXT_FRAME : translational velocity of the camera expressed in
+    the robot frame and rotational velocity expressed in the camera frame.
+
+  The camera frame is defined by set_cMe(). The transformations are computed
+  there once, so that a velocity change of frame only costs a 6x6 product.
 
   \param vel : A 6 dimension vector that corresponds to the velocities to apply to the robot.
 
+  When the command publisher thread is enabled with setCommandRate(), the
+  velocity is only recorded and published by the thread at the next period.
+  setVelocity() must then not be called concurrently from several threads.
+
   \exception vpRobotException::wrongStateError : If the specified control frame is not supported.
 
   */
 void vpROSRobot::setVelocity(const vpRobot::vpControlFrameType frame, const vpColVector &vel)
 {
-  geometry_msgs::Twist msg;
-  if (frame == vpRobot::REFERENCE_FRAME)
+  struct timespec timestamp;
+  timestamp.tv_sec = 0;
+  timestamp.tv_nsec = 0;
+  setVelocity(frame, vel, timestamp);
+}
+
+
+/*!
+  Set the velocity (frame has to be specified) that will be applied to the
+  robot, with the stamp of the sensor data it was computed from.
+
+  When the commands are stamped, see setCommandStamped(), the stamp is
+  published in the geometry_msgs::TwistStamped header, also when the command
+  is published again by the fixed rate command publisher. The base driver can
+  then drop stale commands, and the sensor to actuation latency can be
+  measured downstream. Typically the stamp is the one given by
+  vpROSGrabber::acquire() for the image the command was computed from.
+
+  \param frame : Control frame, see setVelocity(const vpRobot::vpControlFrameType, const vpColVector &).
+
+  \param vel : A 6 dimension vector that corresponds to the velocities to apply to the robot.
+
+  \param timestamp : ROS time of the data the command was computed from. A
+  null stamp is replaced by the current time.
+
+  \exception vpRobotException::wrongStateError : If the specified control frame is not supported.
+  */
+void vpROSRobot::setVelocity(const vpRobot::vpControlFrameType frame, const vpColVector &vel, const struct timespec &timestamp)
+{
+  switch(frame)
   {
-      msg.linear.x = vel[0];
-      msg.linear.y = vel[1];
-      msg.linear.z = vel[2];
-      msg.angular.x = vel[3];
-      msg.angular.y = vel[4];
-      msg.angular.z = vel[5];
-      cmdvel.publish(msg);
+  case vpRobot::REFERENCE_FRAME:
+  case vpRobot::ARTICULAR_FRAME:
+      for(unsigned int i = 0; i < 6; i++)
+          cmd.v[i] = vel[i];
+      break;
+  case vpRobot::CAMERA_FRAME:
+      changeFrame(eVc, vel, cmd.v);
+      break;
+  case vpRobot::MIXT_FRAME:
+      changeFrame(eVm, vel, cmd.v);
+      break;
+  default:
+    throw vpRobotException (vpRobotException::wrongStateError,
+                            "Cannot send the robot velocity in the specified control frame");
+  }
+  if(_cmd_stamped && timestamp.tv_sec == 0 && timestamp.tv_nsec == 0){
+      ros::Time now = ros::Time::now();
+      cmd.sec = now.sec;
+      cmd.nsec = now.nsec;
+  }
+  else{
+      cmd.sec = (uint32_t)timestamp.tv_sec;
+      cmd.nsec = (uint32_t)timestamp.tv_nsec;
+  }
+  if(cmd_running.load(boost::memory_order_acquire)){
+          cmd.seq++;
+          cmd.t_mono = monotonicTime();
+          cmd_lock.store(cmd);
   }
   else
-  {
+      publishVelocity(cmd.v, cmd.sec, cmd.nsec);
+}
+
+
+/*!
+  Publish geometry_msgs::TwistStamped instead of geometry_msgs::Twist
+  velocity commands. Has to be called before init().
+
+  \param stamped : true to publish stamped commands.
+
+  \param frame_id : Frame of the stamped commands, prefixed by the namespace
+  given to setNodespace().
+
+  \sa setVelocity(const vpRobot::vpControlFrameType, const vpColVector &, const struct timespec &)
+  */
+void vpROSRobot::setCommandStamped(bool stamped, const std::string &frame_id)
+{
+  if(isInitialized){
     throw vpRobotException (vpRobotException::wrongStateError,
-                            "Cannot send the robot velocity in the specified control frame");
+                            "Cannot change the command message type once initialized");
+  }
+  _cmd_stamped = stamped;
+  _cmd_frame = frame_id;
+}
+
+
+void vpROSRobot::changeFrame(const vpMatrix &M, const vpColVector &vel, double v[6])
+{
+  for(unsigned int i = 0; i < 6; i++){
+    double s = 0.;
+    for(unsigned int j = 0; j < 6; j++)
+      s += M[i][j] * vel[j];
+    v[i] = s;
+  }
+}
+
+
+void vpROSRobot::publishVelocity(const double v[6], uint32_t sec, uint32_t nsec)
+{
+  if(_latency_enabled)
+    probeLatency(v);
+  if(_cmd_stamped){
+    geometry_msgs::TwistStamped msg;
+    if(sec == 0 && nsec == 0)
+      msg.header.stamp = ros::Time::now();
+    else
+      msg.header.stamp = ros::Time(sec, nsec);
+    msg.header.frame_id = cmd_frame_id;
+    msg.twist.linear.x = v[0];
+    msg.twist.linear.y = v[1];
+    msg.twist.linear.z = v[2];
+    msg.twist.angular.x = v[3];
+    msg.twist.angular.y = v[4];
+    msg.twist.angular.z = v[5];
+    cmdvel.publish(msg);
+  }
+  else{
+    geometry_msgs::Twist msg;
+    msg.linear.x = v[0];
+    msg.linear.y = v[1];
+    msg.linear.z = v[2];
+    msg.angular.x = v[3];
+    msg.angular.y = v[4];
+    msg.angular.z = v[5];
+    cmdvel.publish(msg);
+  }
+}
+
+
+/*!
+  Measure the latency between the velocity commands and their effect on the
+  odometry.
+
+  When enabled, each published command that changes a twist component by
+  at least \e step starts a measurement, unless one is already pending. The
+  command is tagged and stamped on the monotonic clock. The odometry callback
+  then waits for this component of the odometry twist to cross the middle
+  of the step. The latency is the time between the publication of the
+  command and the reception of that odometry message, so it includes the
+  transport, the base driver and the actuation.
+
+  \param enable : Enable or disable the measurement.
+
+  \param step : Minimum variation of a twist component, in m/s or rad/s, to
+  start a measurement.
+
+  \param window : Number of last latencies used by the statistics.
+
+  \param timeout : Time in seconds after which a step not observed in the
+  odometry is counted as lost.
+
+  \sa getLatencyStats()
+  */
+void vpROSRobot::setLatencyMeasurement(bool enable, double step, unsigned int window, double timeout)
+{
+  boost::mutex::scoped_lock lock(latency_mutex);
+  _latency_enabled = enable;
+  _latency_step = (step > 0.) ? step : 0.05;
+  _latency_timeout = (timeout > 0.) ? timeout : 1.;
+  latency_window.assign((window > 0) ? window : 1, 0.);
+  latency_stats.bin_width = 0.001;
+  latency_stats.histogram.assign(500, 0);
+  latency_stats.measured = latency_stats.lost = 0;
+  latency_stats.last = latency_stats.mean = latency_stats.min = latency_stats.max = 0.;
+  latency_count = 0;
+}
+
+
+/*!
+  Get the command to odometry latency statistics.
+
+  \param stats : Statistics over the last latencies, see setLatencyMeasurement().
+  The histogram has 1 ms bins.
+  */
+void vpROSRobot::getLatencyStats(vpROSLatencyStats &stats)
+{
+  boost::mutex::scoped_lock lock(latency_mutex);
+  stats = latency_stats;
+  size_t n = (latency_count < latency_window.size()) ? latency_count : latency_window.size();
+  stats.mean = 0.;
+  stats.min = stats.max = (n > 0) ? latency_window[0] : 0.;
+  for(size_t i = 0; i < n; i++){
+    stats.mean += latency_window[i];
+    stats.min = MIN(stats.min, latency_window[i]);
+    stats.max = MAX(stats.max, latency_window[i]);
+  }
+  if(n > 0)
+    stats.mean /= n;
+}
+
+
+/*!
+  Reset the command to odometry latency statistics.
+  */
+void vpROSRobot::resetLatencyStats()
+{
+  boost::mutex::scoped_lock lock(latency_mutex);
+  latency_stats.histogram.assign(latency_stats.histogram.size(), 0);
+  latency_stats.measured = latency_stats.lost = 0;
+  latency_stats.last = 0.;
+  latency_count = 0;
+}
+
+
+void vpROSRobot::probeLatency(const double v[6])
+{
+  unsigned int axis = 6;
+  double largest = 0.;
+  for(unsigned int i = 0; i < 6; i++){
+    double d = fabs(v[i] - latency_last_cmd[i]);
+    if(d >= _latency_step && d > largest){
+      largest = d;
+      axis = i;
+    }
+    latency_last_cmd[i] = v[i];
+  }
+  if(axis == 6)
+    return;
+
+  double now = monotonicTime();
+  if(latency_seq != latency_done.load(boost::memory_order_acquire)){
+    vpROSLatencyProbe pending;
+    latency_probe.load(pending);
+    if(now - pending.t_mono < _latency_timeout)
+      return;
+  }
+
+  vpROSOdomState state;
+  odom_lock.load(state);
+  if(fabs(v[axis] - state.v[axis]) < _latency_step)
+    return;
+  vpROSLatencyProbe probe;
+  probe.seq = ++latency_seq;
+  probe.axis = axis;
+  probe.base = state.v[axis];
+  probe.target = v[axis];
+  probe.t_mono = now;
+  latency_probe.store(probe);
+}
+
+
+void vpROSRobot::measureLatency(const vpColVector &v)
+{
+  vpROSLatencyProbe probe;
+  latency_probe.load(probe);
+  if(probe.seq == latency_done.load(boost::memory_order_relaxed))
+    return;
+  double latency = odom_state.t_mono - probe.t_mono;
+  if(latency > _latency_timeout){
+    latency_done.store(probe.seq, boost::memory_order_release);
+    boost::mutex::scoped_lock lock(latency_mutex);
+    latency_stats.lost++;
+    return;
+  }
+  double half = 0.5 * (probe.base + probe.target);
+  bool crossed = (probe.target > probe.base) ? (v[probe.axis] >= half) : (v[probe.axis] <= half);
+  if(crossed){
+    latency_done.store(probe.seq, boost::memory_order_release);
+    addLatency(latency);
+  }
+}
+
+
+void vpROSRobot::addLatency(double latency)
+{
+  boost::mutex::scoped_lock lock(latency_mutex);
+  std::vector<unsigned long> &h = latency_stats.histogram;
+  double &slot = latency_window[latency_count % latency_window.size()];
+  if(latency_count >= latency_window.size()){
+    // Remove the latency leaving the window from the histogram
+    size_t bin = MIN((size_t)(slot / latency_stats.bin_width), h.size() - 1);
+    if(h[bin] > 0)
+      h[bin]--;
+  }
+  slot = latency;
+  h[MIN((size_t)(latency / latency_stats.bin_width), h.size() - 1)]++;
+  latency_count++;
+  latency_stats.measured++;
+  latency_stats.last = latency;
+}
+
+
+/*!
+  Publish the commanded velocity at a fixed rate from a dedicated thread.
+
+  By default setVelocity() publishes a message at each call. With a command
+  rate, setVelocity() only records the velocity and a thread publishes the
+  last recorded one at each period: bursts of setVelocity() calls are
+  coalesced and the base receives a steady stream even if the control loop
+  stalls. The thread sleeps until absolute deadlines on the monotonic clock
+  so that its rate does not drift; see getCommandStats() for its jitter.
+
+  \param hz : Publishing rate in Hz. 0 disables the thread and returns to
+  one message per setVelocity() call.
+
+  \sa setMaxAcceleration()
+  */
+void vpROSRobot::setCommandRate(double hz)
+{
+  stopCommandThread();
+  _cmd_rate = (hz > 0.) ? hz : 0.;
+  if(isInitialized && _cmd_rate > 0.)
+    startCommandThread();
+}
+
+
+/*!
+  Limit the variation of the velocity published by the command publisher
+  thread. The limit is applied at the command rate, see setCommandRate().
+
+  \param linear : Maximum linear acceleration in m/s^2, 0 for no limit.
+
+  \param angular : Maximum angular acceleration in rad/s^2, 0 for no limit.
+  */
+void vpROSRobot::setMaxAcceleration(double linear, double angular)
+{
+  _max_acc_linear = (linear > 0.) ? linear : 0.;
+  _max_acc_angular = (angular > 0.) ? angular : 0.;
+}
+
+
+/*!
+  Stop the robot when setVelocity() is not called anymore.
+
+  The command publisher thread, see setCommandRate(), publishes a zero
+  velocity when the last setVelocity() call is older than the timeout,
+  measured on the monotonic clock. The acceleration limit is bypassed so
+  that the robot stops as fast as the base allows. Each expiry is counted in
+  vpROSCommandStats::watchdog. A new setVelocity() call resumes the
+  publication of the commanded velocity.
+
+  \param timeout : Timeout in seconds, 0 disables the watchdog.
+  */
+void vpROSRobot::setCommandTimeout(double timeout)
+{
+  _cmd_timeout = (timeout > 0.) ? timeout : 0.;
+}
+
+
+/*!
+  Get the statistics of the command publisher thread.
+
+  \param stats : Statistics since the thread start or the last resetCommandStats() call.
+  */
+void vpROSRobot::getCommandStats(vpROSCommandStats &stats)
+{
+  boost::mutex::scoped_lock lock(cmd_stats_mutex);
+  stats = cmd_stats;
+}
+
+
+/*!
+  Reset the statistics of the command publisher thread.
+  */
+void vpROSRobot::resetCommandStats()
+{
+  boost::mutex::scoped_lock lock(cmd_stats_mutex);
+  memset(&cmd_stats, 0, sizeof(cmd_stats));
+}
+
+
+void vpROSRobot::startCommandThread()
+{
+  if(cmd_thread)
+    return;
+  cmd.seq++;
+  cmd.t_mono = monotonicTime();
+  cmd_lock.store(cmd);
+  cmd_running.store(true, boost::memory_order_release);
+  cmd_thread = new boost::thread(boost::bind(&vpROSRobot::commandLoop, this));
+}
+
+
+void vpROSRobot::stopCommandThread()
+{
+  if(!cmd_thread)
+    return;
+  cmd_running.store(false, boost::memory_order_release);
+  cmd_thread->join();
+  delete cmd_thread;
+  cmd_thread = NULL;
+}
+
+
+void vpROSRobot::commandLoop()
+{
+  const double period = 1. / _cmd_rate;
+  const long period_ns = (long)(period * 1000000000.0);
+  double out[6] = {0., 0., 0., 0., 0., 0.};
+  unsigned long last_seq = 0;
+  bool expired = false;
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+  while(cmd_running.load(boost::memory_order_acquire)){
+    deadline.tv_nsec += period_ns;
+    while(deadline.tv_nsec >= 1000000000L){
+      deadline.tv_nsec -= 1000000000L;
+      deadline.tv_sec++;
+    }
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR);
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double late = (double)(now.tv_sec - deadline.tv_sec) + (double)(now.tv_nsec - deadline.tv_nsec) / 1000000000.0;
+    unsigned long missed = 0;
+    if(late > period){
+      // Skip the missed periods instead of publishing a burst to catch up
+      missed = (unsigned long)(late / period);
+      deadline = now;
+    }
+
+    vpROSCommand c;
+    cmd_lock.load(c);
+    double t_now = (double)now.tv_sec + (double)now.tv_nsec / 1000000000.0;
+    bool timeout = (_cmd_timeout > 0.) && (t_now - c.t_mono > _cmd_timeout);
+    bool trigger = timeout && !expired;
+    expired = timeout;
+    for(unsigned int i = 0; i < 6; i++){
+      if(timeout){
+        out[i] = 0.;
+        continue;
+      }
+      double target = c.v[i];
+      double max_acc = (i < 3) ? _max_acc_linear : _max_acc_angular;
+      if(max_acc > 0.){
+        double dv_max = max_acc * period;
+        target = CLIP(target, out[i] - dv_max, out[i] + dv_max);
+      }
+      out[i] = target;
+    }
+    // The watchdog zero command is stamped with the current time
+    if(timeout)
+      publishVelocity(out, 0, 0);
+    else
+      publishVelocity(out, c.sec, c.nsec);
+
+    boost::mutex::scoped_lock lock(cmd_stats_mutex);
+    cmd_stats.published++;
+    if(c.seq > last_seq + 1 && last_seq != 0)
+      cmd_stats.coalesced += c.seq - last_seq - 1;
+    last_seq = c.seq;
+    cmd_stats.overruns += missed;
+    if(trigger)
+      cmd_stats.watchdog++;
+    if(late < 0.)
+      late = 0.;
+    cmd_stats.jitter_mean += (late - cmd_stats.jitter_mean) / cmd_stats.published;
+    if(late > cmd_stats.jitter_max)
+      cmd_stats.jitter_max = late;
   }
 }
 
@@ -186,35 +895,551 @@ void vpROSRobot::setVelocity(const vpRobot::vpControlFrameType frame, const vpCo
 
   */
 void vpROSRobot::getPosition(const vpRobot::vpControlFrameType frame, vpColVector &pose) {
-      while(!odom_mutex);
-      odom_mutex = false;
-      if (frame == vpRobot::REFERENCE_FRAME)
+      if (frame != vpRobot::REFERENCE_FRAME)
       {
-          pose.resize(6);
-          pose[0] = p[0];
-          pose[1] = p[1];
-          pose[2] = p[2];
-          vpRotationMatrix R(q);
-          vpRxyzVector V(R);
-          pose[3]=V[0];
-          pose[4]=V[1];
-          pose[5]=V[2];
-       }
-       else
-       {
-         throw vpRobotException (vpRobotException::wrongStateError,
+        throw vpRobotException (vpRobotException::wrongStateError,
                                 "Cannot get the robot position in the specified control frame");
-       }
-       odom_mutex = true;
+      }
+      vpROSOdomState state;
+      odom_lock.load(state);
+      vpHomogeneousMatrix delta;
+      double horizon;
+      if(predict(state, delta, horizon)){
+          vpHomogeneousMatrix fMe;
+          vpRotationMatrix fRe(vpQuaternionVector(state.q[0], state.q[1], state.q[2], state.q[3]));
+          fMe.buildFrom(vpTranslationVector(state.p[0], state.p[1], state.p[2]), fRe);
+          fMe = fMe * delta;
+          vpRotationMatrix R;
+          fMe.extract(R);
+          vpRxyzVector V(R);
+          pose.resize(6);
+          for(unsigned int i = 0; i < 3; i++){
+              pose[i] = fMe[i][3];
+              pose[i+3] = V[i];
+          }
+      }
+      else
+          toPose(state.p, state.q, pose);
 }
 
 
 /*!
-  Get the robot displacement (frame has to be specified).
+  Get the robot velocity from the twist of the last odometry message.
+
+  \param frame : Control frame.
+  - vpRobot::REFERENCE_FRAME and vpRobot::ARTICULAR_FRAME : twist of the
+    robot expressed in its own frame, with the same convention as the
+    velocity given to setVelocity().
+  - vpRobot::CAMERA_FRAME : twist expressed in the camera frame, using the
+    transformation given to set_cMe().
+
+  \param velocity : A 6 dimension vector (vx, vy, vz, wx, wy, wz).
+
+  \param timestamp : Stamp of the odometry message the velocity comes from.
+
+  \exception vpRobotException::wrongStateError : If the specified control frame is not supported.
+  */
+void vpROSRobot::getVelocity(const vpRobot::vpControlFrameType frame, vpColVector &velocity, struct timespec &timestamp)
+{
+  if(frame != vpRobot::REFERENCE_FRAME && frame != vpRobot::ARTICULAR_FRAME && frame != vpRobot::CAMERA_FRAME){
+    throw vpRobotException (vpRobotException::wrongStateError,
+                            "Cannot get the robot velocity in the specified control frame");
+  }
+  vpROSOdomState state;
+  odom_lock.load(state);
+  timestamp.tv_sec = state.sec;
+  timestamp.tv_nsec = state.nsec;
+  velocity.resize(6);
+  for(unsigned int i = 0; i < 6; i++)
+    velocity[i] = state.v[i];
+  if(frame == vpRobot::CAMERA_FRAME)
+    velocity = cVe * velocity;
+}
+
+
+/*!
+  Get the robot velocity from the twist of the last odometry message.
+
+  \param frame : Control frame, see getVelocity(const vpRobot::vpControlFrameType, vpColVector &, struct timespec &).
+
+  \param velocity : A 6 dimension vector (vx, vy, vz, wx, wy, wz).
+  */
+void vpROSRobot::getVelocity(const vpRobot::vpControlFrameType frame, vpColVector &velocity)
+{
+  struct timespec timestamp;
+  getVelocity(frame, velocity, timestamp);
+}
+
+
+/*!
+  Get the robot velocity from the twist of the last odometry message.
+
+  \param frame : Control frame, see getVelocity(const vpRobot::vpControlFrameType, vpColVector &, struct timespec &).
+
+  \return A 6 dimension vector (vx, vy, vz, wx, wy, wz).
+  */
+vpColVector vpROSRobot::getVelocity(const vpRobot::vpControlFrameType frame)
+{
+  vpColVector velocity;
+  getVelocity(frame, velocity);
+  return velocity;
+}
+
+
+/*!
+  Set the transformation between the camera frame and the robot frame used by
+  the vpRobot::CAMERA_FRAME and vpRobot::MIXT_FRAME velocities and
+  displacements. The twist transformations are computed here and reused by
+  each setVelocity(), getVelocity() and getDisplacement() call.
+
+  \param cMe : Robot frame in the camera frame.
+  */
+void vpROSRobot::set_cMe(const vpHomogeneousMatrix &cMe)
+{
+  _cMe = cMe;
+  _eMc = cMe.inverse();
+  cVe.buildFrom(_cMe);
+  eVc.buildFrom(_eMc);
+
+  // Mixt frame: (v, w) with v the camera velocity in the robot frame and w
+  // the camera rotation in the camera frame. The robot twist at its origin is
+  // ve = v + [etc]x eRc w and we = eRc w.
+  vpRotationMatrix eRc;
+  vpTranslationVector etc;
+  _eMc.extract(eRc);
+  _eMc.extract(etc);
+  vpMatrix skew_eRc = vpTranslationVector::skew(etc) * eRc;
+  eVm.resize(6, 6);
+  for(unsigned int i = 0; i < 3; i++){
+    eVm[i][i] = 1.;
+    for(unsigned int j = 0; j < 3; j++){
+      eVm[i][j+3] = skew_eRc[i][j];
+      eVm[i+3][j+3] = eRc[i][j];
+    }
+  }
+}
+
+
+/*!
+  Move the robot to a pose and wait until it is reached.
+
+  The move is done by a controller stepped by the odometry callback, so at
+  the odometry rate and without polling, see setPositionAsync().
+
+  \param frame : Control frame. Only vpRobot::REFERENCE_FRAME is implemented.
+
+  \param pose : Target pose (x, y, z, rx, ry, rz) as given by getPosition().
+  Only x, y and the heading rz are controlled.
+
+  \warning The wait is not bounded: it never returns if the odometry stops,
+  and it deadlocks if called from a callback of the queue given to
+  init(ros::CallbackQueue *), since the odometry callback stepping the move
+  can then no more run. Use setPosition(const vpRobot::vpControlFrameType, const vpColVector &, double)
+  or setPositionAsync() in such cases.
+
+  \exception vpRobotException::wrongStateError : If the specified control frame is not supported.
+  \exception vpRobotException::notInitializedError : If the robot is not initialized.
+  */
+void vpROSRobot::setPosition(const vpRobot::vpControlFrameType frame, const vpColVector &pose)
+{
+  setPositionAsync(frame, pose).wait();
+}
+
+
+/*!
+  Move the robot to a pose and wait until it is reached, at most for a given
+  time. On timeout the move is cancelled and the robot stopped.
+
+  \param frame : Control frame. Only vpRobot::REFERENCE_FRAME is implemented.
+
+  \param pose : Target pose, see setPosition(const vpRobot::vpControlFrameType, const vpColVector &).
+
+  \param timeout : Maximum duration of the move in seconds.
+
+  \return true if the pose was reached, false on timeout or if the move was
+  cancelled or preempted.
+
+  \exception vpRobotException::wrongStateError : If the specified control frame is not supported.
+  \exception vpRobotException::notInitializedError : If the robot is not initialized.
+  */
+bool vpROSRobot::setPosition(const vpRobot::vpControlFrameType frame, const vpColVector &pose, double timeout)
+{
+  boost::unique_future<bool> future = setPositionAsync(frame, pose);
+  long ms = (timeout > 0.) ? (long)(timeout * 1000.) : 0;
+  if(!future.timed_wait(boost::posix_time::milliseconds(ms))){
+    cancelPosition();
+    return false;
+  }
+  return future.get();
+}
+
+
+/*!
+  Start a move to a pose and return immediately.
+
+  A unicycle controller is stepped in the odometry callback: the robot turns
+  towards the target, drives to it and then turns to the target heading.
+  The velocity is applied through applyControllerVelocity(). setVelocity()
+  must not be called during the move. A new move preempts the current one.
+
+  \param frame : Control frame. Only vpRobot::REFERENCE_FRAME is implemented.
+
+  \param pose : Target pose (x, y, z, rx, ry, rz) as given by getPosition().
+  Only x, y and the heading rz are controlled.
+
+  \return Future set to true when the pose is reached, false if the move is
+  cancelled or preempted.
+
+  \exception vpRobotException::wrongStateError : If the specified control frame is not supported.
+  \exception vpRobotException::notInitializedError : If the robot is not initialized.
+
+  \sa setPositionTolerance(), setPositionMaxVelocity(), cancelPosition()
+  */
+boost::unique_future<bool> vpROSRobot::setPositionAsync(const vpRobot::vpControlFrameType frame, const vpColVector &pose)
+{
+  std::vector<vpColVector> waypoints(1, pose);
+  return setWaypointsAsync(frame, waypoints);
+}
+
+
+/*!
+  Start a move through a list of poses and return immediately. The
+  intermediate poses are passed through without stopping and without
+  aligning the heading; only the last one is reached as with setPositionAsync().
+
+  \param frame : Control frame. Only vpRobot::REFERENCE_FRAME is implemented.
+
+  \param waypoints : Poses (x, y, z, rx, ry, rz) to go through.
+
+  \return Future set to true when the last pose is reached, false if the move
+  is cancelled or preempted.
+
+  \exception vpRobotException::wrongStateError : If the specified control frame is not supported.
+  \exception vpRobotException::notInitializedError : If the robot is not initialized.
+  */
+boost::unique_future<bool> vpROSRobot::setWaypointsAsync(const vpRobot::vpControlFrameType frame, const std::vector<vpColVector> &waypoints)
+{
+  if(frame != vpRobot::REFERENCE_FRAME){
+    throw vpRobotException (vpRobotException::wrongStateError,
+                            "Cannot set the robot position in the specified control frame");
+  }
+  if(!isInitialized){
+    throw vpRobotException (vpRobotException::notInitializedError,
+                            "Cannot set the robot position before init()");
+  }
+  boost::shared_ptr< boost::promise<bool> > promise(new boost::promise<bool>);
+  boost::unique_future<bool> future = promise->get_future();
+
+  boost::mutex::scoped_lock lock(pos_mutex);
+  if(pos_active)
+    finishPosition(false);
+  pos_waypoints.clear();
+  for(size_t i = 0; i < waypoints.size(); i++){
+    vpColVector wp(3);
+    wp[0] = waypoints[i][0];
+    wp[1] = waypoints[i][1];
+    wp[2] = (waypoints[i].size() >= 6) ? waypoints[i][5] : 0.;
+    pos_waypoints.push_back(wp);
+  }
+  if(pos_waypoints.empty()){
+    promise->set_value(true);
+    return future;
+  }
+  pos_promise = promise;
+  pos_aligning = false;
+  pos_active.store(true, boost::memory_order_release);
+  return future;
+}
+
+
+/*!
+  Stop the current move, if any. Its future is set to false.
+  */
+void vpROSRobot::cancelPosition()
+{
+  boost::mutex::scoped_lock lock(pos_mutex);
+  if(!pos_active)
+    return;
+  finishPosition(false);
+  applyControllerVelocity(0., 0.);
+}
+
+
+/*!
+  Set the tolerances under which a pose is considered reached.
+
+  \param distance : Position tolerance in meters, 0.05 by default.
+  \param angle : Heading tolerance in radians, 0.05 by default.
+  */
+void vpROSRobot::setPositionTolerance(double distance, double angle)
+{
+  boost::mutex::scoped_lock lock(pos_mutex);
+  _pos_tolerance = (distance > 0.) ? distance : 0.05;
+  _pos_angle_tolerance = (angle > 0.) ? angle : 0.05;
+}
+
+
+/*!
+  Set the maximum velocities of the position controller.
+
+  \param v : Translation velocity in m/s, 0.3 by default.
+  \param w : Rotation velocity in rad/s, 0.5 by default.
+  */
+void vpROSRobot::setPositionMaxVelocity(double v, double w)
+{
+  boost::mutex::scoped_lock lock(pos_mutex);
+  _pos_max_v = (v > 0.) ? v : 0.3;
+  _pos_max_w = (w > 0.) ? w : 0.5;
+}
+
+
+/*!
+  Apply the velocity computed by the position controller. Called from the
+  odometry callback. Derived classes override it to apply their own
+  saturations, as vpROSRobotPioneer.
+
+  \param v : Translation velocity along x in m/s.
+  \param w : Rotation velocity around z in rad/s.
+  */
+void vpROSRobot::applyControllerVelocity(double v, double w)
+{
+  vpColVector vel(6);
+  vel[0] = v;
+  vel[5] = w;
+  vpROSRobot::setVelocity(vpRobot::REFERENCE_FRAME, vel);
+}
+
+
+/*
+  Called with pos_mutex held.
+*/
+void vpROSRobot::finishPosition(bool reached)
+{
+  pos_active.store(false, boost::memory_order_release);
+  pos_waypoints.clear();
+  if(pos_promise){
+    pos_promise->set_value(reached);
+    pos_promise.reset();
+  }
+}
+
+
+void vpROSRobot::stepPositionController()
+{
+  boost::mutex::scoped_lock lock(pos_mutex);
+  if(!pos_active || pos_waypoints.empty())
+    return;
+
+  const double *p = odom_state.p;
+  const double *q = odom_state.q;
+  double theta = atan2(2. * (q[3] * q[2] + q[0] * q[1]), 1. - 2. * (q[1] * q[1] + q[2] * q[2]));
+  const vpColVector &goal = pos_waypoints.front();
+  bool last = (pos_waypoints.size() == 1);
+
+  double dx = goal[0] - p[0];
+  double dy = goal[1] - p[1];
+  double rho = sqrt(dx * dx + dy * dy);
+  double v = 0., w = 0.;
+
+  // Intermediate waypoints are passed through with a larger tolerance
+  if(!last && rho <= 3. * _pos_tolerance){
+    pos_waypoints.erase(pos_waypoints.begin());
+    return;
+  }
+  // Once at the goal, keep aligning the heading unless pushed clearly away:
+  // turning towards a target a few cm away would spin the robot
+  if(last){
+    if(!pos_aligning && rho <= _pos_tolerance)
+      pos_aligning = true;
+    else if(pos_aligning && rho > 2. * _pos_tolerance)
+      pos_aligning = false;
+  }
+
+  if(!pos_aligning){
+    double alpha = atan2(dy, dx) - theta;
+    alpha = atan2(sin(alpha), cos(alpha));
+    w = CLIP(1.5 * alpha, -_pos_max_w, _pos_max_w);
+    // Turn towards the target before driving
+    if(fabs(alpha) < M_PI / 4.)
+      v = CLIP(0.8 * rho * cos(alpha), 0., _pos_max_v);
+  }
+  else{
+    double etheta = goal[2] - theta;
+    etheta = atan2(sin(etheta), cos(etheta));
+    if(fabs(etheta) <= _pos_angle_tolerance){
+      finishPosition(true);
+      applyControllerVelocity(0., 0.);
+      return;
+    }
+    w = CLIP(1.5 * etheta, -_pos_max_w, _pos_max_w);
+  }
+  applyControllerVelocity(v, w);
+}
+
+
+/*!
+  Enable the extrapolation of the odometry between two messages.
+
+  When enabled, getPosition() and getDisplacement() extrapolate the last
+  received odometry up to the current time, measured with a monotonic clock
+  since the reception of the last message. This allows control loops running
+  faster than the odometry to get an up to date pose.
+
+  \param type : Prediction model.
+
+  \param max_horizon : Maximum extrapolation in seconds (0.2 s by default).
+  Beyond, the pose is extrapolated up to this horizon only.
+
+  \sa getPredictionHorizon()
+  */
+void vpROSRobot::setPrediction(vpPredictionType type, double max_horizon)
+{
+  _prediction = type;
+  _prediction_max_horizon = (max_horizon > 0.) ? max_horizon : 0.;
+  _prediction_horizon.store(0.);
+}
+
+
+/*!
+  Compute the motion of the robot between the reception of the last odometry
+  message and now.
+
+  \param state : Last odometry state.
+
+  \param delta : Motion expressed in the robot frame of the last message.
+
+  \param h : Extrapolation horizon in seconds, 0 when no prediction is done.
+
+  \return false if no prediction is done.
+  */
+bool vpROSRobot::predict(const vpROSOdomState &state, vpHomogeneousMatrix &delta, double &h)
+{
+  h = 0.;
+  _prediction_horizon.store(0.);
+  if(_prediction == PREDICTION_NONE || state.t_mono == 0.)
+    return false;
+  h = monotonicTime() - state.t_mono;
+  if(h <= 0.){
+    h = 0.;
+    return false;
+  }
+  if(h > _prediction_max_horizon)
+    h = _prediction_max_horizon;
+
+  vpColVector v(6);
+  for(unsigned int i = 0; i < 6; i++){
+    v[i] = state.v[i];
+    if(_prediction == PREDICTION_CONSTANT_ACCELERATION)
+      v[i] += 0.5 * state.a[i] * h; // mean velocity over the horizon
+  }
+  delta = vpExponentialMap::direct(v * h);
+  _prediction_horizon.store(h);
+  return true;
+}
+
+
+/*!
+  Get the robot position at a given time (frame has to be specified).
+
+  The position is interpolated between the two odometry samples of the
+  history that bracket the requested time: linearly for the translation and
+  by spherical linear interpolation (SLERP) for the orientation. This allows
+  to get the robot position at the timestamp of an image.
 
   \param frame : Control frame. For the moment, only vpRobot::REFERENCE_FRAME is implemented.
 
+  \param pose : A 6 dimension vector that corresponds to the position of the robot.
+
+  \param timestamp : Time at which the position is requested, in the same
+  time base as the odometry messages stamps.
+
+  \exception vpRobotException::wrongStateError : If the specified control frame
+  is not supported, or if the time is not covered by the odometry history.
+
+  \sa setOdometryHistorySize()
+  */
+void vpROSRobot::getPosition(const vpRobot::vpControlFrameType frame, vpColVector &pose, const struct timespec &timestamp) {
+  if (frame != vpRobot::REFERENCE_FRAME)
+  {
+    throw vpRobotException (vpRobotException::wrongStateError,
+                            "Cannot get the robot position in the specified control frame");
+  }
+  const double t = (double)timestamp.tv_sec + (double)timestamp.tv_nsec / 1000000000.0;
+  const unsigned long size = odom_history.size();
+  vpROSOdomSample s0, s1;
+
+  for(;;){
+    unsigned long count = odom_history_count.load(boost::memory_order_acquire);
+    // The slot following the newest sample may be under writing, skip it
+    unsigned long first = (count > size - 1) ? count - (size - 1) : 0;
+    if(count == 0 || t < odom_history[first % size].t || t > odom_history[(count - 1) % size].t){
+      if(odom_history_count.load(boost::memory_order_acquire) != count)
+        continue;
+      throw vpRobotException (vpRobotException::wrongStateError,
+                              "Requested time is outside of the odometry history");
+    }
+
+    // Binary search of the first sample not older than t
+    unsigned long lo = first, hi = count - 1;
+    while(lo < hi){
+      unsigned long mid = lo + (hi - lo) / 2;
+      if(odom_history[mid % size].t < t)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    s1 = odom_history[lo % size];
+    s0 = (lo > first) ? odom_history[(lo - 1) % size] : s1;
+
+    // Retry if the writer overwrote one of the samples read meanwhile
+    boost::atomic_thread_fence(boost::memory_order_acquire);
+    unsigned long count2 = odom_history_count.load(boost::memory_order_relaxed);
+    if(count2 < size || first > count2 - size)
+      break;
+  }
+
+  double s = (s1.t > s0.t) ? (t - s0.t) / (s1.t - s0.t) : 1.;
+  double p[3], q[4];
+  for(unsigned int i = 0; i < 3; i++)
+    p[i] = s0.p[i] + s * (s1.p[i] - s0.p[i]);
+  slerp(s0.q, s1.q, s, q);
+  toPose(p, q, pose);
+}
+
+
+/*!
+  Set the number of odometry samples kept to interpolate past positions.
+  Has to be called before init().
+
+  \param size : Number of samples (256 by default).
+
+  \exception vpRobotException::wrongStateError : If the robot is already initialized.
+
+  \sa getPosition(const vpRobot::vpControlFrameType, vpColVector &, const struct timespec &)
+  */
+void vpROSRobot::setOdometryHistorySize(unsigned int size)
+{
+  if(isInitialized){
+    throw vpRobotException (vpRobotException::wrongStateError,
+                            "Cannot change the odometry history size once initialized");
+  }
+  odom_history.resize((size > 2) ? size : 2);
+  odom_history_count.store(0);
+}
+
+
+/*!
+  Get the robot displacement (frame has to be specified).
+
+  \param frame : Control frame.
+  - vpRobot::REFERENCE_FRAME and vpRobot::ARTICULAR_FRAME : displacement of the robot frame.
+  - vpRobot::CAMERA_FRAME : displacement of the camera frame, see set_cMe().
+  - vpRobot::MIXT_FRAME : translation of the camera expressed in the robot frame
+    and rotation of the camera frame.
+
   \param dis : A 6 dimension vector that corresponds to the displacement of the robot since the last call to the function.
+  The first three values are the translation and the last three the rotation as a \f$\theta u\f$ vector,
+  both expressed in the frame at the previous call.
 
   \param timestamp : timestamp of the last update of the displacement
 
@@ -222,21 +1447,45 @@ void vpROSRobot::getPosition(const vpRobot::vpControlFrameType frame, vpColVecto
 
   */
   void vpROSRobot::getDisplacement(const vpRobot::vpControlFrameType frame, vpColVector &dis, struct timespec &timestamp){
-      while(!odom_mutex);
-      odom_mutex = false;     
-      vpColVector pose_cur(displacement);
-      timestamp.tv_sec = _sec;
-      timestamp.tv_nsec = _nsec;
-      odom_mutex = true;
-      if(frame == vpRobot::REFERENCE_FRAME){
-          dis = pose_cur - pose_prev;
-          pose_prev = pose_cur;
-      }
-      else
-      {
+      if(frame != vpRobot::REFERENCE_FRAME && frame != vpRobot::ARTICULAR_FRAME
+         && frame != vpRobot::CAMERA_FRAME && frame != vpRobot::MIXT_FRAME){
         throw vpRobotException (vpRobotException::wrongStateError,
                                 "Cannot get robot displacement in the specified control frame");
       }
+      vpROSOdomState state;
+      odom_lock.load(state);
+      timestamp.tv_sec = state.sec;
+      timestamp.tv_nsec = state.nsec;
+      vpHomogeneousMatrix disp_cur;
+      fromArrays(state.disp_R, state.disp_t, disp_cur);
+      vpHomogeneousMatrix delta;
+      double horizon;
+      if(predict(state, delta, horizon)){
+          disp_cur = disp_cur * delta;
+          double stamp = (double)state.nsec / 1000000000.0 + horizon;
+          timestamp.tv_sec += (time_t)stamp;
+          timestamp.tv_nsec = (long)((stamp - floor(stamp)) * 1000000000.0);
+      }
+      vpHomogeneousMatrix prevMcur = disp_prev.inverse() * disp_cur;
+      disp_prev = disp_cur;
+      if(frame == vpRobot::CAMERA_FRAME || frame == vpRobot::MIXT_FRAME)
+          prevMcur = _cMe * prevMcur * _eMc;
+
+      vpTranslationVector t;
+      vpRotationMatrix R;
+      prevMcur.extract(t);
+      prevMcur.extract(R);
+      vpThetaUVector tu(R);
+      if(frame == vpRobot::MIXT_FRAME){
+          vpRotationMatrix eRc;
+          _eMc.extract(eRc);
+          t = eRc * t;
+      }
+      dis.resize(6);
+      for(unsigned int i = 0; i < 3; i++){
+          dis[i] = t[i];
+          dis[i+3] = tu[i];
+      }
   }
 
   /*!
@@ -256,23 +1505,114 @@ void vpROSRobot::getPosition(const vpRobot::vpControlFrameType frame, vpColVecto
 
 
 void vpROSRobot::odomCallback(const nav_msgs::Odometry::ConstPtr& msg){
-    while(!odom_mutex);
-    odom_mutex = false;
-    p.set(msg->pose.pose.position.x,msg->pose.pose.position.y,msg->pose.pose.position.z);
-    q.set(msg->pose.pose.orientation.x,msg->pose.pose.orientation.y,msg->pose.pose.orientation.z,msg->pose.pose.orientation.w);
-    
-    if(_sec != 0 || _nsec != 0){
-        double dt = ((double)msg->header.stamp.sec - (double)_sec) + ((double)msg->header.stamp.nsec - (double)_nsec) / 1000000000.0;
-        displacement[0] += msg->twist.twist.linear.x * dt;
-        displacement[1] += msg->twist.twist.linear.y * dt;
-        displacement[2] += msg->twist.twist.linear.z * dt;
-        displacement[3] += msg->twist.twist.angular.x * dt;
-        displacement[4] += msg->twist.twist.angular.y * dt;
-        displacement[5] += msg->twist.twist.angular.z * dt;
+    // odom_state is only accessed from this callback, readers use odom_lock
+    bool integrate = (odom_state.sec != 0 || odom_state.nsec != 0);
+    double dt = 0.;
+    if(integrate){
+        dt = ((double)msg->header.stamp.sec - (double)odom_state.sec) + ((double)msg->header.stamp.nsec - (double)odom_state.nsec) / 1000000000.0;
+        // Duplicated or out of order stamp: nothing to integrate, and the state must not go back in time
+        if(dt <= 0.)
+            return;
+    }
+
+    odom_state.p[0] = msg->pose.pose.position.x;
+    odom_state.p[1] = msg->pose.pose.position.y;
+    odom_state.p[2] = msg->pose.pose.position.z;
+    odom_state.q[0] = msg->pose.pose.orientation.x;
+    odom_state.q[1] = msg->pose.pose.orientation.y;
+    odom_state.q[2] = msg->pose.pose.orientation.z;
+    odom_state.q[3] = msg->pose.pose.orientation.w;
+
+    vpColVector v(6);
+    v[0] = msg->twist.twist.linear.x;
+    v[1] = msg->twist.twist.linear.y;
+    v[2] = msg->twist.twist.linear.z;
+    v[3] = msg->twist.twist.angular.x;
+    v[4] = msg->twist.twist.angular.y;
+    v[5] = msg->twist.twist.angular.z;
+
+    if(integrate){
+        odom_burst_v.push_back(v);
+        odom_burst_dt.push_back(dt);
+        for(unsigned int i = 0; i < 6; i++)
+            odom_state.a[i] = (v[i] - odom_state.v[i]) / dt;
+    }
+    // A burst of queued messages is integrated once its last message is handled. On a
+    // shared queue the other callbacks could delay it, each message is integrated alone.
+    if(!odom_burst_v.empty() && (spin_thread == NULL || queue->isEmpty() || odom_burst_v.size() >= odom_queue_size)){
+        integrateDisplacement(odom_disp, odom_burst_v, odom_burst_dt);
+        toArrays(odom_disp, odom_state.disp_R, odom_state.disp_t);
+        odom_burst_v.clear();
+        odom_burst_dt.clear();
+    }
+    for(unsigned int i = 0; i < 6; i++)
+        odom_state.v[i] = v[i];
+    odom_state.t_mono = monotonicTime();
+    odom_state.sec = msg->header.stamp.sec;
+    odom_state.nsec = msg->header.stamp.nsec;
+    odom_lock.store(odom_state);
+    if(_latency_enabled)
+        measureLatency(v);
+
+    // The binary search of getPosition() needs strictly increasing stamps, drop out of order samples
+    unsigned long count = odom_history_count.load(boost::memory_order_relaxed);
+    double t = msg->header.stamp.toSec();
+    if(count == 0 || t > odom_history[(count - 1) % odom_history.size()].t){
+        // Order the slot writes after the previous count publication, as vpROSSeqLock::store() does
+        boost::atomic_thread_fence(boost::memory_order_release);
+        vpROSOdomSample &sample = odom_history[count % odom_history.size()];
+        sample.t = t;
+        memcpy(sample.p, odom_state.p, sizeof(sample.p));
+        memcpy(sample.q, odom_state.q, sizeof(sample.q));
+        odom_history_count.store(count + 1, boost::memory_order_release);
     }
-    _sec = msg->header.stamp.sec;
-    _nsec = msg->header.stamp.nsec;
-    odom_mutex = true;
+
+    if(pos_active.load(boost::memory_order_acquire))
+        stepPositionController();
+}
+
+
+/*!
+  Integrate a constant twist over a time interval with the SE(3) exponential map.
+  Contrary to a component-wise integration, the result is exact whatever the
+  rotation of the robot during the interval.
+
+  \param M : Pose to update, right multiplied by the motion over the interval.
+
+  \param v : Twist (vx, vy, vz, wx, wy, wz) expressed in the frame of M, as
+  given by the twist of a nav_msgs::Odometry message.
+
+  \param dt : Duration of the interval in seconds.
+  */
+void vpROSRobot::integrateDisplacement(vpHomogeneousMatrix &M, const vpColVector &v, double dt)
+{
+  M = M * vpExponentialMap::direct(v * dt);
+  orthonormalize(M);
+}
+
+
+/*!
+  Integrate a sequence of constant twists with the SE(3) exponential map,
+  as for a burst of queued odometry messages. The rotation is orthonormalized
+  once at the end of the sequence.
+
+  \param M : Pose to update, right multiplied by the motion over all the intervals.
+
+  \param v : Twists (vx, vy, vz, wx, wy, wz), each one expressed in the frame reached at the beginning of its interval.
+
+  \param dt : Durations of the intervals in seconds.
+
+  \exception vpRobotException::dimensionError : If v and dt have different sizes.
+  */
+void vpROSRobot::integrateDisplacement(vpHomogeneousMatrix &M, const std::vector<vpColVector> &v, const std::vector<double> &dt)
+{
+  if(v.size() != dt.size()){
+    throw vpRobotException (vpRobotException::dimensionError,
+                            "Twist and duration vectors have different sizes");
+  }
+  for(size_t i = 0; i < v.size(); i++)
+    M = M * vpExponentialMap::direct(v[i] * dt[i]);
+  orthonormalize(M);
 }
 
 
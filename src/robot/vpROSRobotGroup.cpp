@@ -0,0 +1,160 @@
+/****************************************************************************
+ *
+ * $Id: vpROSRobotGroup.cpp $
+ *
+ * This file is part of the ViSP software.
+ * Copyright (C) 2005 - 2014 by INRIA. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact INRIA about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://www.irisa.fr/lagadic/visp/visp.html for more information.
+ *
+ * This software was developed at:
+ * INRIA Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ * http://www.irisa.fr/lagadic
+ *
+ * If you have questions regarding the use of this file, please contact
+ * INRIA at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *
+ * Description:
+ * Group of vpROSRobot sharing a callback queue and a spinner.
+ *
+ * Authors:
+ * agent
+ *
+ *****************************************************************************/
+
+/*!
+  \file vpROSRobotGroup.cpp
+  \brief Group of vpROSRobot sharing a callback queue and a spinner.
+*/
+
+#include <visp_ros/vpROSRobotGroup.h>
+#include <visp/vpRobotException.h>
+
+/*!
+  Constructor.
+
+  \param nthreads : Number of threads serving the odometry callbacks of all the robots.
+*/
+vpROSRobotGroup::vpROSRobotGroup(unsigned int nthreads) :
+  n(NULL),
+  spinner(NULL),
+  _nthreads((nthreads > 0) ? nthreads : 1),
+  isInitialized(false)
+{
+
+}
+
+/*!
+  Destructor. Stops the threads and deletes the robots, then their node handle.
+*/
+vpROSRobotGroup::~vpROSRobotGroup()
+{
+  if(spinner){
+    spinner->stop();
+    delete spinner;
+  }
+  for(size_t i = 0; i < robots.size(); i++)
+    delete robots[i];
+  delete n;
+}
+
+/*!
+  Add a robot to the group. Its topics have to be set, typically with
+  vpROSRobot::setNodespace(), before init().
+
+  \param robot : Robot allocated with new, deleted by the group.
+
+  \return Index of the robot in the group.
+
+  \exception vpRobotException::wrongStateError : If the group is already initialized.
+*/
+size_t vpROSRobotGroup::add(vpROSRobot *robot)
+{
+  if(isInitialized)
+    throw vpRobotException(vpRobotException::wrongStateError, "Cannot add a robot to an initialized group");
+  robots.push_back(robot);
+  return robots.size() - 1;
+}
+
+/*!
+  Initialize ROS if needed, register the robots on the shared node handle and
+  start the threads serving its queue.
+
+  \param argc, argv : parameters of the main function
+*/
+void vpROSRobotGroup::init(int argc, char **argv)
+{
+  if(isInitialized)
+    return;
+  if(!ros::isInitialized())
+    ros::init(argc, argv, "visp_node", ros::init_options::AnonymousName);
+  n = new ros::NodeHandle;
+  n->setCallbackQueue(&queue);
+  for(size_t i = 0; i < robots.size(); i++)
+    robots[i]->init(n);
+  spinner = new ros::AsyncSpinner(_nthreads, &queue);
+  spinner->start();
+  isInitialized = true;
+}
+
+/*!
+  Set the velocity of all the robots.
+
+  \param frame : Control frame, see vpROSRobot::setVelocity().
+
+  \param vel : One velocity per robot, in the order of add().
+
+  \exception vpRobotException::dimensionError : If the number of velocities is not the number of robots.
+*/
+void vpROSRobotGroup::setVelocity(const vpRobot::vpControlFrameType frame, const std::vector<vpColVector> &vel)
+{
+  if(vel.size() != robots.size())
+    throw vpRobotException(vpRobotException::dimensionError, "The number of velocities does not match the number of robots");
+  for(size_t i = 0; i < robots.size(); i++)
+    robots[i]->setVelocity(frame, vel[i]);
+}
+
+/*!
+  Get the position of all the robots.
+
+  \param frame : Control frame, see vpROSRobot::getPosition().
+
+  \param pose : One pose per robot, in the order of add().
+*/
+void vpROSRobotGroup::getPosition(const vpRobot::vpControlFrameType frame, std::vector<vpColVector> &pose)
+{
+  pose.resize(robots.size());
+  for(size_t i = 0; i < robots.size(); i++)
+    robots[i]->getPosition(frame, pose[i]);
+}
+
+/*!
+  Get the velocity of all the robots.
+
+  \param frame : Control frame, see vpROSRobot::getVelocity().
+
+  \param vel : One velocity per robot, in the order of add().
+*/
+void vpROSRobotGroup::getVelocity(const vpRobot::vpControlFrameType frame, std::vector<vpColVector> &vel)
+{
+  vel.resize(robots.size());
+  for(size_t i = 0; i < robots.size(); i++)
+    robots[i]->getVelocity(frame, vel[i]);
+}
@@ -0,0 +1,379 @@
+/****************************************************************************
+ *
+ * $Id: test_grabber_allocations.cpp $
+ *
+ * This file is part of the ViSP software.
+ * Copyright (C) 2005 - 2014 by INRIA. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact INRIA about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://www.irisa.fr/lagadic/visp/visp.html for more information.
+ *
+ * This software was developed at:
+ * INRIA Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ * http://www.irisa.fr/lagadic
+ *
+ * If you have questions regarding the use of this file, please contact
+ * INRIA at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *
+ * Description:
+ * Check that vpROSGrabber does not allocate memory in steady state.
+ *
+ * Authors:
+ * Fabien Spindler
+ *
+ *****************************************************************************/
+
+/*!
+  \file test_grabber_allocations.cpp
+  \brief Check that vpROSGrabber does not allocate memory in steady state.
+
+  The image callbacks are fed directly with fixed size messages while the
+  malloc family is counted. The buffer pool behind acquire(struct timespec &)
+  and acquireAsync() is checked for reuse and for its misses.
+*/
+
+#include <visp_ros/vpROSGrabber.h>
+
+#if defined(VISP_HAVE_OPENCV)
+
+#include <visp/vpImage.h>
+#include <visp/vpRGBa.h>
+#include <sensor_msgs/CameraInfo.h>
+#include <sensor_msgs/CompressedImage.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/image_encodings.h>
+#include <gtest/gtest.h>
+#include <opencv2/core/core.hpp>
+#include <boost/thread/future.hpp>
+#include <errno.h>
+#include <stdlib.h>
+#include <vector>
+
+// Allocation counter, enabled only around the measured code
+static volatile bool counting = false;
+static volatile unsigned long allocations = 0;
+
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *ptr);
+
+static inline void countAllocation()
+{
+  if(counting)
+    __sync_fetch_and_add(&allocations, 1);
+}
+
+void *malloc(size_t size) __THROW
+{
+  countAllocation();
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) __THROW
+{
+  countAllocation();
+  return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size) __THROW
+{
+  countAllocation();
+  return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size) __THROW
+{
+  countAllocation();
+  return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) __THROW
+{
+  countAllocation();
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size) __THROW
+{
+  countAllocation();
+  *ptr = __libc_memalign(alignment, size);
+  return (*ptr == NULL) ? ENOMEM : 0;
+}
+
+void free(void *ptr) __THROW
+{
+  __libc_free(ptr);
+}
+
+}
+
+namespace {
+
+const unsigned int width = 320;
+const unsigned int height = 240;
+const unsigned int warmup = 5;
+const unsigned int frames = 20;
+
+/*
+  Give access to the callbacks and fake an opened grabber, without ROS master.
+*/
+class vpROSGrabberTest : public vpROSGrabber
+{
+  public:
+    vpROSGrabberTest() { isInitialized = true; }
+    ~vpROSGrabberTest() { isInitialized = false; }
+
+    using vpROSGrabber::imageCallback;
+    using vpROSGrabber::imageCallbackRaw;
+    using vpROSGrabber::paramCallback;
+};
+
+cv::Mat makeImage()
+{
+  cv::Mat image(height, width, CV_8UC3);
+  cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(255));
+  return image;
+}
+
+sensor_msgs::CameraInfoPtr makeCameraInfo()
+{
+  sensor_msgs::CameraInfoPtr info(new sensor_msgs::CameraInfo);
+  info->width = width;
+  info->height = height;
+  info->distortion_model = "plumb_bob";
+  info->D.resize(5, 0.);
+  info->D[0] = -0.2;
+  info->D[1] = 0.05;
+  double K[9] = { 300., 0., width / 2., 0., 300., height / 2., 0., 0., 1. };
+  double R[9] = { 1., 0., 0., 0., 1., 0., 0., 0., 1. };
+  double P[12] = { 300., 0., width / 2., 0., 0., 300., height / 2., 0., 0., 0., 1., 0. };
+  for(unsigned int i = 0; i < 9; i++){
+    info->K[i] = K[i];
+    info->R[i] = R[i];
+  }
+  for(unsigned int i = 0; i < 12; i++)
+    info->P[i] = P[i];
+  return info;
+}
+
+sensor_msgs::ImagePtr makeRawMessage(const cv::Mat &image)
+{
+  sensor_msgs::ImagePtr msg(new sensor_msgs::Image);
+  msg->width = width;
+  msg->height = height;
+  msg->encoding = sensor_msgs::image_encodings::BGR8;
+  msg->step = width * 3;
+  msg->data.assign(image.data, image.data + height * width * 3);
+  return msg;
+}
+
+sensor_msgs::CompressedImagePtr makeCompressedMessage(const cv::Mat &image)
+{
+  sensor_msgs::CompressedImagePtr msg(new sensor_msgs::CompressedImage);
+  msg->format = "jpeg";
+  cv::imencode(".jpg", image, msg->data);
+  return msg;
+}
+
+void stamp(std_msgs::Header &header, unsigned int i)
+{
+  header.stamp = ros::Time(1000. + i / 30.);
+}
+
+}
+
+class GrabberAllocations : public ::testing::TestWithParam<bool>
+{
+  protected:
+    void SetUp()
+    {
+      // The OpenCV thread pool allocates its tasks
+      cv::setNumThreads(0);
+      grabber.setRectify(GetParam());
+      grabber.paramCallback(makeCameraInfo());
+      image = makeImage();
+    }
+
+    vpROSGrabberTest grabber;
+    cv::Mat image;
+    vpImage<vpRGBa> I;
+    struct timespec timestamp;
+};
+
+TEST_P(GrabberAllocations, rawImage)
+{
+  sensor_msgs::ImagePtr msg = makeRawMessage(image);
+
+  for(unsigned int i = 0; i < warmup; i++){
+    stamp(msg->header, i);
+    grabber.imageCallbackRaw(msg);
+    grabber.acquireNoWait(I, timestamp);
+  }
+
+  allocations = 0;
+  counting = true;
+  for(unsigned int i = warmup; i < warmup + frames; i++){
+    stamp(msg->header, i);
+    grabber.imageCallbackRaw(msg);
+    grabber.acquireNoWait(I, timestamp);
+  }
+  counting = false;
+
+  EXPECT_EQ(0UL, allocations);
+}
+
+/*
+  The OpenCV decoders allocate their own state for each image, which the
+  grabber cannot avoid: the callback must not allocate more than a bare
+  cv::imdecode() of the same image into a reused buffer.
+*/
+TEST_P(GrabberAllocations, compressedImage)
+{
+  sensor_msgs::CompressedImagePtr msg = makeCompressedMessage(image);
+
+  cv::Mat decoded;
+  cv::imdecode(cv::Mat(msg->data), 1, &decoded);
+  allocations = 0;
+  counting = true;
+  for(unsigned int i = 0; i < frames; i++)
+    cv::imdecode(cv::Mat(msg->data), 1, &decoded);
+  counting = false;
+  unsigned long decoder_allocations = allocations;
+
+  for(unsigned int i = 0; i < warmup; i++){
+    stamp(msg->header, i);
+    grabber.imageCallback(msg);
+    grabber.acquireNoWait(I, timestamp);
+  }
+
+  allocations = 0;
+  counting = true;
+  for(unsigned int i = warmup; i < warmup + frames; i++){
+    stamp(msg->header, i);
+    grabber.imageCallback(msg);
+    grabber.acquireNoWait(I, timestamp);
+  }
+  counting = false;
+
+  EXPECT_LE(allocations, decoder_allocations);
+}
+
+/*
+  Images returned by acquire(struct timespec &) and released before the next
+  one are copied in the pool buffers, without any allocation.
+*/
+TEST_P(GrabberAllocations, poolReuse)
+{
+  sensor_msgs::ImagePtr msg = makeRawMessage(image);
+  cv::Mat acquired;
+
+  for(unsigned int i = 0; i < warmup; i++){
+    stamp(msg->header, i);
+    grabber.imageCallbackRaw(msg);
+    acquired = grabber.acquire(timestamp);
+  }
+
+  allocations = 0;
+  counting = true;
+  for(unsigned int i = warmup; i < warmup + frames; i++){
+    stamp(msg->header, i);
+    grabber.imageCallbackRaw(msg);
+    acquired = grabber.acquire(timestamp);
+  }
+  counting = false;
+
+  EXPECT_EQ(0UL, allocations);
+  EXPECT_EQ(0UL, grabber.getBufferPoolMisses());
+  EXPECT_EQ(width, (unsigned int)acquired.cols);
+  EXPECT_EQ(height, (unsigned int)acquired.rows);
+}
+
+/*
+  Each image kept by the user beyond the pool size is a miss.
+*/
+TEST_P(GrabberAllocations, poolMisses)
+{
+  const unsigned int pool = 2;
+  const unsigned int kept = 5;
+  grabber.setBufferPoolSize(pool);
+  sensor_msgs::ImagePtr msg = makeRawMessage(image);
+
+  std::vector<cv::Mat> acquired;
+  for(unsigned int i = 0; i < kept; i++){
+    stamp(msg->header, i);
+    grabber.imageCallbackRaw(msg);
+    acquired.push_back(grabber.acquire(timestamp));
+    EXPECT_EQ((unsigned long)(i < pool ? 0 : i + 1 - pool), grabber.getBufferPoolMisses());
+  }
+
+  // Once released, the pool buffers are reused again
+  acquired.clear();
+  stamp(msg->header, kept);
+  grabber.imageCallbackRaw(msg);
+  acquired.push_back(grabber.acquire(timestamp));
+  EXPECT_EQ((unsigned long)(kept - pool), grabber.getBufferPoolMisses());
+}
+
+/*
+  acquireAsync() frames come from the same pool.
+*/
+TEST_P(GrabberAllocations, asyncPoolMisses)
+{
+  const unsigned int pool = 2;
+  const unsigned int kept = 4;
+  grabber.setBufferPoolSize(pool);
+  sensor_msgs::ImagePtr msg = makeRawMessage(image);
+
+  std::vector<cv::Mat> acquired;
+  for(unsigned int i = 0; i < kept; i++){
+    boost::unique_future<vpROSGrabber::Frame> future = grabber.acquireAsync();
+    EXPECT_FALSE(future.is_ready());
+    stamp(msg->header, i);
+    grabber.imageCallbackRaw(msg);
+    ASSERT_TRUE(future.is_ready());
+    vpROSGrabber::Frame frame = future.get();
+    EXPECT_EQ(msg->header.stamp.sec, (uint32_t)frame.timestamp.tv_sec);
+    EXPECT_EQ(msg->header.stamp.nsec, (uint32_t)frame.timestamp.tv_nsec);
+    acquired.push_back(frame.image);
+  }
+  EXPECT_EQ((unsigned long)(kept - pool), grabber.getBufferPoolMisses());
+
+  // A released frame goes back to the pool
+  acquired.clear();
+  boost::unique_future<vpROSGrabber::Frame> future = grabber.acquireAsync();
+  stamp(msg->header, kept);
+  grabber.imageCallbackRaw(msg);
+  ASSERT_TRUE(future.is_ready());
+  future.get();
+  EXPECT_EQ((unsigned long)(kept - pool), grabber.getBufferPoolMisses());
+}
+
+INSTANTIATE_TEST_CASE_P(Rectify, GrabberAllocations, ::testing::Values(false, true));
+
+#endif
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
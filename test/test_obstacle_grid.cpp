@@ -0,0 +1,128 @@
+/****************************************************************************
+ *
+ * $Id: test_obstacle_grid.cpp $
+ *
+ * This file is part of the ViSP software.
+ * Copyright (C) 2005 - 2014 by INRIA. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact INRIA about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://www.irisa.fr/lagadic/visp/visp.html for more information.
+ *
+ * This software was developed at:
+ * INRIA Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ * http://www.irisa.fr/lagadic
+ *
+ * If you have questions regarding the use of this file, please contact
+ * INRIA at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *
+ * Description:
+ * Check the free distances given by vpROSObstacleGrid.
+ *
+ * Authors:
+ * Fabien Spindler
+ *
+ *****************************************************************************/
+
+/*!
+  \file test_obstacle_grid.cpp
+  \brief Check the free distances given by vpROSObstacleGrid.
+*/
+
+#include <visp_ros/vpROSObstacleGrid.h>
+#include <gtest/gtest.h>
+
+namespace {
+
+const double size = 4.;
+const double resolution = 0.05;
+const double radius = 0.3;
+const double max_distance = 1.;
+
+}
+
+TEST(ObstacleGrid, freeArc)
+{
+  vpROSObstacleGrid grid(size, resolution, radius);
+  EXPECT_DOUBLE_EQ(max_distance, grid.getFreeDistance(0.2, 0., max_distance));
+  EXPECT_DOUBLE_EQ(max_distance, grid.getFreeDistance(-0.2, 0.5, max_distance));
+}
+
+TEST(ObstacleGrid, obstacleAhead)
+{
+  vpROSObstacleGrid grid(size, resolution, radius);
+  float x[1] = { 0.8f }, y[1] = { 0.f };
+  grid.update(0, x, y, 1);
+
+  double forward = grid.getFreeDistance(0.2, 0., max_distance);
+  EXPECT_NEAR(0.8 - radius, forward, 2 * resolution);
+  EXPECT_DOUBLE_EQ(max_distance, grid.getFreeDistance(-0.2, 0., max_distance));
+  // A rotation in place does not sweep any new cell
+  EXPECT_DOUBLE_EQ(max_distance, grid.getFreeDistance(0., 1., max_distance));
+}
+
+/*
+  Once an obstacle is within the robot radius, the robot must still be able
+  to move away from it, but not closer.
+*/
+TEST(ObstacleGrid, overlappingObstacle)
+{
+  vpROSObstacleGrid grid(size, resolution, radius);
+  float x[1] = { 0.25f }, y[1] = { 0.f };
+  grid.update(0, x, y, 1);
+
+  EXPECT_DOUBLE_EQ(0., grid.getFreeDistance(0.2, 0., max_distance));
+  EXPECT_DOUBLE_EQ(0., grid.getFreeDistance(0.2, 0.5, max_distance));
+  EXPECT_DOUBLE_EQ(max_distance, grid.getFreeDistance(-0.2, 0., max_distance));
+  EXPECT_DOUBLE_EQ(max_distance, grid.getFreeDistance(-0.2, 0.5, max_distance));
+}
+
+/*
+  Backing off an overlapping obstacle is still limited by the other ones.
+*/
+TEST(ObstacleGrid, overlappingObstacleAndObstacleBehind)
+{
+  vpROSObstacleGrid grid(size, resolution, radius);
+  float x[2] = { 0.25f, -0.9f }, y[2] = { 0.f, 0.f };
+  grid.update(0, x, y, 2);
+
+  EXPECT_DOUBLE_EQ(0., grid.getFreeDistance(0.2, 0., max_distance));
+  double backward = grid.getFreeDistance(-0.2, 0., max_distance);
+  EXPECT_NEAR(0.9 - radius, backward, 2 * resolution);
+}
+
+/*
+  The points of a source replace its previous points only.
+*/
+TEST(ObstacleGrid, updateSource)
+{
+  vpROSObstacleGrid grid(size, resolution, radius);
+  float x0[1] = { 0.25f }, y0[1] = { 0.f };
+  float x1[1] = { 0.8f }, y1[1] = { 0.f };
+  grid.update(0, x0, y0, 1);
+  grid.update(1, x1, y1, 1);
+  grid.update(0, NULL, NULL, 0);
+
+  EXPECT_NEAR(0.8 - radius, grid.getFreeDistance(0.2, 0., max_distance), 2 * resolution);
+}
+
+int main(int argc, char **argv)
+{
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
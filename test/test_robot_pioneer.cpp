@@ -0,0 +1,152 @@
+/****************************************************************************
+ *
+ * $Id: test_robot_pioneer.cpp $
+ *
+ * This file is part of the ViSP software.
+ * Copyright (C) 2005 - 2014 by INRIA. All rights reserved.
+ *
+ * This software is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * ("GPL") version 2 as published by the Free Software Foundation.
+ * See the file LICENSE.txt at the root directory of this source
+ * distribution for additional information about the GNU GPL.
+ *
+ * For using ViSP with software that can not be combined with the GNU
+ * GPL, please contact INRIA about acquiring a ViSP Professional
+ * Edition License.
+ *
+ * See http://www.irisa.fr/lagadic/visp/visp.html for more information.
+ *
+ * This software was developed at:
+ * INRIA Rennes - Bretagne Atlantique
+ * Campus Universitaire de Beaulieu
+ * 35042 Rennes Cedex
+ * France
+ * http://www.irisa.fr/lagadic
+ *
+ * If you have questions regarding the use of this file, please contact
+ * INRIA at visp@inria.fr
+ *
+ * This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+ * WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ *
+ * Description:
+ * Check the vpROSRobotPioneer state read from the odometry.
+ *
+ * Authors:
+ * Fabien Spindler
+ *
+ *****************************************************************************/
+
+/*!
+  \file test_robot_pioneer.cpp
+  \brief Check the vpROSRobotPioneer state read from the odometry and the
+  safety layer.
+
+  The odometry and laser callbacks are fed directly, without ROS master.
+*/
+
+#include <visp_ros/vpROSRobotPioneer.h>
+#include <visp/vpRobotException.h>
+#include <nav_msgs/Odometry.h>
+#include <sensor_msgs/LaserScan.h>
+#include <boost/thread/mutex.hpp>
+#include <ros/time.h>
+#include <gtest/gtest.h>
+
+namespace {
+
+/*
+  Give access to the sensor callbacks and to the safety layer.
+*/
+class vpROSRobotPioneerTest : public vpROSRobotPioneer
+{
+  public:
+    using vpROSRobot::odomCallback;
+    using vpROSRobotPioneer::laserCallback;
+    using vpROSRobotPioneer::safetyScale;
+    using vpROSRobotPioneer::sensor_mutex;
+};
+
+nav_msgs::OdometryPtr makeOdometry(double t, double v, double w)
+{
+  nav_msgs::OdometryPtr msg(new nav_msgs::Odometry);
+  msg->header.stamp = ros::Time(t);
+  msg->pose.pose.orientation.w = 1.;
+  msg->twist.twist.linear.x = v;
+  msg->twist.twist.angular.z = w;
+  return msg;
+}
+
+/*
+  Single beam scan along the x axis of the robot.
+*/
+sensor_msgs::LaserScanPtr makeScan(double t, float range)
+{
+  sensor_msgs::LaserScanPtr msg(new sensor_msgs::LaserScan);
+  msg->header.stamp = ros::Time(t);
+  msg->angle_min = 0.f;
+  msg->angle_max = 0.f;
+  msg->angle_increment = 0.01f;
+  msg->range_min = 0.05f;
+  msg->range_max = 10.f;
+  msg->ranges.push_back(range);
+  return msg;
+}
+
+}
+
+TEST(RobotPioneer, referenceVelocity)
+{
+  vpROSRobotPioneerTest robot;
+  robot.odomCallback(makeOdometry(1000., 0.4, -0.2));
+
+  vpColVector velocity = robot.getVelocity(vpRobot::REFERENCE_FRAME);
+  ASSERT_EQ(2u, velocity.getRows());
+  EXPECT_DOUBLE_EQ(0.4, velocity[0]);
+  EXPECT_DOUBLE_EQ(-0.2, velocity[1]);
+
+  // Also after a resize of the caller vector
+  velocity.resize(6);
+  robot.odomCallback(makeOdometry(1000.1, -0.3, 0.5));
+  robot.getVelocity(vpRobot::REFERENCE_FRAME, velocity);
+  ASSERT_EQ(2u, velocity.getRows());
+  EXPECT_DOUBLE_EQ(-0.3, velocity[0]);
+  EXPECT_DOUBLE_EQ(0.5, velocity[1]);
+}
+
+TEST(RobotPioneer, articularVelocity)
+{
+  vpROSRobotPioneerTest robot;
+  robot.odomCallback(makeOdometry(1000., 0.4, -0.2));
+
+  vpColVector velocity;
+  EXPECT_THROW(robot.getVelocity(vpRobot::ARTICULAR_FRAME, velocity), vpRobotException);
+}
+
+/*
+  An obstacle closer than the robot radius stops the motions toward it but
+  not the ones that move away from it, also when the grid is busy.
+*/
+TEST(RobotPioneer, safetyOverlappingObstacle)
+{
+  vpROSRobotPioneerTest robot;
+  robot.setSafety(true, 0.1, 0.5);
+  robot.laserCallback(makeScan(1000., 0.25f));
+
+  EXPECT_DOUBLE_EQ(0., robot.safetyScale(0.2, 0.));
+  EXPECT_DOUBLE_EQ(1., robot.safetyScale(-0.2, 0.));
+
+  // Fallback on the nearest obstacles while a scan is being inserted
+  boost::mutex::scoped_lock lock(robot.sensor_mutex);
+  EXPECT_DOUBLE_EQ(0., robot.safetyScale(0.2, 0.));
+  EXPECT_DOUBLE_EQ(1., robot.safetyScale(-0.2, 0.));
+}
+
+int main(int argc, char **argv)
+{
+  ros::Time::init();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}